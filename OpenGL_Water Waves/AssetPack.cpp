@@ -0,0 +1,209 @@
+#include "stdafx.h"
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "Tables.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+	MappedFile pack;
+	const AssetPackEntry * entries = NULL;
+	const char * names = NULL;
+	uint32_t entryCount = 0;
+
+	// "./map\\a.png" and "map/a.png" name the same asset
+	std::string assetName(const char * path) {
+		std::string name = path;
+		std::replace(name.begin(), name.end(), '\\', '/');
+		while (name.compare(0, 2, "./") == 0) name.erase(0, 2);
+		return name;
+	}
+
+	size_t alignUp(size_t offset) {
+		return (offset + ASSET_PACK_ALIGN - 1) & ~(size_t)(ASSET_PACK_ALIGN - 1);
+	}
+
+	// Bounds of the header, entries and names; payloads are checked per entry
+	const AssetPackHeader * validateHeader(const unsigned char * data, size_t size, const char * path) {
+		if (size < sizeof(AssetPackHeader)) {
+			printf("Asset pack %s is too small to contain a header\n", path);
+			return NULL;
+		}
+		const AssetPackHeader * header = (const AssetPackHeader *)data;
+		if (memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0 || header->version != ASSET_PACK_VERSION) {
+			printf("Asset pack %s has an unknown format or version\n", path);
+			return NULL;
+		}
+		if (header->entriesOffset % alignof(AssetPackEntry) != 0 || header->entriesOffset > size ||
+			(size - header->entriesOffset) / sizeof(AssetPackEntry) < header->entryCount ||
+			header->namesOffset > size || size - header->namesOffset < header->namesSize) {
+			printf("Asset pack %s is truncated\n", path);
+			return NULL;
+		}
+
+		const AssetPackEntry * toc = (const AssetPackEntry *)(data + header->entriesOffset);
+		for (uint32_t i = 0; i < header->entryCount; i++) {
+			if (toc[i].offset > size || size - toc[i].offset < toc[i].size ||
+				toc[i].nameOffset > header->namesSize || header->namesSize - toc[i].nameOffset < toc[i].nameLength) {
+				printf("Asset pack %s has an entry out of bounds\n", path);
+				return NULL;
+			}
+		}
+		return header;
+	}
+
+	int compareName(const AssetPackEntry & entry, const std::string & name) {
+		int c = memcmp(names + entry.nameOffset, name.data(), std::min((size_t)entry.nameLength, name.size()));
+		if (c != 0) return c;
+		return entry.nameLength < name.size() ? -1 : (entry.nameLength > name.size() ? 1 : 0);
+	}
+}
+
+bool mountAssetPack(const char * path) {
+	unmountAssetPack();
+
+	MappedFile file;
+	if (!file.openFile(path)) {
+		printf("Asset pack %s could not be opened\n", path);
+		return false;
+	}
+	const AssetPackHeader * header = validateHeader(file.data(), file.size(), path);
+	if (header == NULL) {
+		return false;
+	}
+
+	entries = (const AssetPackEntry *)(file.data() + header->entriesOffset);
+	names = (const char *)file.data() + header->namesOffset;
+	entryCount = header->entryCount;
+	pack = std::move(file);
+
+	printf("Mounted asset pack %s (%u files, %.1f MB)\n", path, entryCount, pack.size() / (1024.0 * 1024.0));
+	return true;
+}
+
+void unmountAssetPack() {
+	pack.close();
+	entries = NULL;
+	names = NULL;
+	entryCount = 0;
+}
+
+bool assetPackMounted() {
+	return pack.isOpen();
+}
+
+const unsigned char * findAsset(const char * path, size_t * size) {
+	if (entryCount == 0) return NULL;
+
+	std::string name = assetName(path);
+	uint32_t lo = 0, hi = entryCount;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int c = compareName(entries[mid], name);
+		if (c == 0) {
+			*size = (size_t)entries[mid].size;
+			return pack.data() + entries[mid].offset;
+		}
+		if (c < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return NULL;
+}
+
+bool writeAssetPack(const char * path, const std::vector<std::string> & files) {
+	std::vector<std::string> sorted;
+	for (const std::string & file : files) sorted.push_back(assetName(file.c_str()));
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	FILE * out = fopen(path, "wb");
+	if (out == NULL) {
+		printf("Asset pack %s could not be opened\n", path);
+		return false;
+	}
+
+	// header last, once the offsets are known
+	static const unsigned char padding[ASSET_PACK_ALIGN] = { 0 };
+	AssetPackHeader header;
+	memset(&header, 0, sizeof(header));
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	size_t offset = sizeof(header);
+
+	std::vector<AssetPackEntry> toc;
+	std::string nameData;
+	for (const std::string & name : sorted) {
+		// the pack being written may be the one mounted, read the loose file
+		MappedFile file;
+		if (!file.openFile(name.c_str())) {
+			printf("Asset %s could not be opened, skipped\n", name.c_str());
+			continue;
+		}
+
+		size_t aligned = alignUp(offset);
+		ok = ok && (aligned == offset || fwrite(padding, aligned - offset, 1, out) == 1);
+		ok = ok && fwrite(file.data(), file.size(), 1, out) == 1;
+
+		AssetPackEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.offset = aligned;
+		entry.size = file.size();
+		entry.nameOffset = (uint32_t)nameData.size();
+		entry.nameLength = (uint32_t)name.size();
+		entry.checksum = tableChecksum(file.data(), file.size());
+		toc.push_back(entry);
+		nameData += name;
+		offset = aligned + file.size();
+	}
+
+	size_t aligned = alignUp(offset);
+	ok = ok && (aligned == offset || fwrite(padding, aligned - offset, 1, out) == 1);
+	memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = (uint32_t)toc.size();
+	header.namesSize = (uint32_t)nameData.size();
+	header.entriesOffset = aligned;
+	header.namesOffset = aligned + toc.size() * sizeof(AssetPackEntry);
+	ok = ok && (toc.empty() || fwrite(toc.data(), sizeof(AssetPackEntry), toc.size(), out) == toc.size());
+	ok = ok && (nameData.empty() || fwrite(nameData.data(), nameData.size(), 1, out) == 1);
+	ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = (fclose(out) == 0) && ok;
+
+	if (!ok) {
+		printf("Asset pack %s could not be written\n", path);
+		remove(path);
+		return false;
+	}
+	printf("Asset pack %s: %u files, %.1f MB\n", path, header.entryCount, (header.namesOffset + header.namesSize) / (1024.0 * 1024.0));
+	return true;
+}
+
+bool verifyAssetPack(const char * path) {
+	MappedFile file;
+	if (!file.openFile(path)) {
+		printf("Asset pack %s could not be opened\n", path);
+		return false;
+	}
+	const AssetPackHeader * header = validateHeader(file.data(), file.size(), path);
+	if (header == NULL) {
+		return false;
+	}
+
+	const AssetPackEntry * toc = (const AssetPackEntry *)(file.data() + header->entriesOffset);
+	const char * text = (const char *)file.data() + header->namesOffset;
+	bool ok = true;
+	for (uint32_t i = 0; i < header->entryCount; i++) {
+		if (toc[i].offset % ASSET_PACK_ALIGN != 0 || tableChecksum(file.data() + toc[i].offset, (size_t)toc[i].size) != toc[i].checksum) {
+			printf("Asset pack %s: %.*s is corrupt\n", path, (int)toc[i].nameLength, text + toc[i].nameOffset);
+			ok = false;
+		}
+		if (i > 0) {
+			std::string previous(text + toc[i - 1].nameOffset, toc[i - 1].nameLength), name(text + toc[i].nameOffset, toc[i].nameLength);
+			if (!(previous < name)) {
+				printf("Asset pack %s is not sorted at %s\n", path, name.c_str());
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef __ASSET_PACK_H__
+#define __ASSET_PACK_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// All assets in one file, mapped once at start up:
+//   AssetPackHeader | payloads | AssetPackEntry[entryCount] | names
+// Payloads start on a 64 byte boundary, entries are sorted by name so lookups
+// are a binary search. Names are relative paths with '/' separators, as the
+// loaders spell them ("map/skydome_Fisheye.bmp", "waves.fs.glsl").
+//
+// While a pack is mounted MappedFile::open() resolves paths inside it first,
+// so every loader built on MappedFile reads views of the pack without copies.
+// Paths missing from the pack still come from the working directory.
+
+#define ASSET_PACK_MAGIC "OPAK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGN 64
+
+struct AssetPackHeader {
+	char     magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t entryCount;
+	uint32_t namesSize;
+	uint64_t entriesOffset; // from the start of the file
+	uint64_t namesOffset;
+};
+
+struct AssetPackEntry {
+	uint64_t offset;     // of the payload, from the start of the file
+	uint64_t size;
+	uint32_t nameOffset; // into the names, not terminated
+	uint32_t nameLength;
+	uint32_t checksum;   // FNV-1a of the payload
+	uint32_t reserved;
+};
+
+// Maps the pack and replaces any mounted before. Call it before anything is
+// loaded; lookups are not synchronized with mounting.
+bool mountAssetPack(const char * path);
+void unmountAssetPack();
+bool assetPackMounted();
+
+// The payload of path in the mounted pack, or NULL
+const unsigned char * findAsset(const char * path, size_t * size);
+
+// Packs files from the working directory under their given names
+bool writeAssetPack(const char * path, const std::vector<std::string> & files);
+
+// Checks the layout and every payload checksum of a pack on disk
+bool verifyAssetPack(const char * path);
+
+#endif __ASSET_PACK_H__
@@ -0,0 +1,333 @@
+#include "stdafx.h"
+#include "Atmosphere.h"
+#include "ThreadPool.h"
+#include "Tables.h"
+#include "Trace.h"
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#ifndef __PI__
+#define __PI__
+#define PI 3.14159265358979323846264338327950288
+#endif __PI__
+
+#define TRANSMITTANCE_INTEGRAL_SAMPLES 250
+#define INSCATTER_INTEGRAL_SAMPLES 50
+#define IRRADIANCE_INTEGRAL_THETA 8
+#define IRRADIANCE_INTEGRAL_PHI 8 // over [0, pi], the integrand is symmetric about the sun plane
+
+AtmosphereParams defaultAtmosphere() {
+	AtmosphereParams p;
+	p.Rg = 6360.0e3f;
+	p.Rt = 6420.0e3f;
+	p.RL = 6421.0e3f;
+	p.HR = 8.0e3f;
+	p.betaR[0] = 5.8e-6f;
+	p.betaR[1] = 1.35e-5f;
+	p.betaR[2] = 3.31e-5f;
+	p.HM = 1.2e3f;
+	for (int i = 0; i < 3; i++) {
+		p.betaMSca[i] = 4e-6f;
+		p.betaMEx[i] = p.betaMSca[i] / 0.9f;
+	}
+	p.mieG = 0.8f;
+	return p;
+}
+
+AtmosphereParams hazyAtmosphere(float haze) {
+	AtmosphereParams p = defaultAtmosphere();
+	for (int i = 0; i < 3; i++) {
+		p.betaMSca[i] *= haze;
+		p.betaMEx[i] *= haze;
+	}
+	return p;
+}
+
+uint32_t atmosphereKey(const AtmosphereParams & params) {
+	return tableChecksum(&params, sizeof(params));
+}
+
+// ----------------------------------------------------------------------------
+// Model, the same formulas as the GPU precomputation of Bruneton's reference code
+// ----------------------------------------------------------------------------
+
+namespace {
+
+struct Model {
+	AtmosphereParams p;
+	glm::vec3 betaR;
+	glm::vec3 betaMSca;
+	glm::vec3 betaMEx;
+	const float * transmittance; // table being read once computed
+
+	// distance to the top atmosphere boundary, or to the ground if the ray hits it
+	float limit(float r, float mu) const {
+		float dout = -r * mu + std::sqrt(std::max(0.0f, r * r * (mu * mu - 1.0f) + p.RL * p.RL));
+		float delta2 = r * r * (mu * mu - 1.0f) + p.Rg * p.Rg;
+		if (delta2 >= 0.0f) {
+			float din = -r * mu - std::sqrt(delta2);
+			if (din >= 0.0f) {
+				dout = std::min(dout, din);
+			}
+		}
+		return dout;
+	}
+
+	float opticalDepth(float H, float r, float mu) const {
+		if (mu < -std::sqrt(std::max(0.0f, 1.0f - (p.Rg / r) * (p.Rg / r)))) {
+			return 1e9f;
+		}
+		float dx = limit(r, mu) / TRANSMITTANCE_INTEGRAL_SAMPLES;
+		float yi = std::exp(-(r - p.Rg) / H);
+		float result = 0.0f;
+		for (int i = 1; i <= TRANSMITTANCE_INTEGRAL_SAMPLES; ++i) {
+			float xj = i * dx;
+			float yj = std::exp(-(std::sqrt(r * r + xj * xj + 2.0f * xj * r * mu) - p.Rg) / H);
+			result += (yi + yj) * 0.5f * dx;
+			yi = yj;
+		}
+		return result;
+	}
+
+	// bilinear lookup with the parametrisation of getTransmittanceUV() in waves.fs.glsl
+	glm::vec3 transmittanceAt(float r, float mu) const {
+		float uR = std::sqrt(std::max(0.0f, (r - p.Rg) / (p.Rt - p.Rg)));
+		float uMu = std::atan((mu + 0.15f) / (1.0f + 0.15f) * std::tan(1.5f)) / 1.5f;
+
+		float x = glm::clamp(uMu * TRANSMITTANCE_W - 0.5f, 0.0f, TRANSMITTANCE_W - 1.0f);
+		float y = glm::clamp(uR * TRANSMITTANCE_H - 0.5f, 0.0f, TRANSMITTANCE_H - 1.0f);
+		int x0 = (int)x, y0 = (int)y;
+		int x1 = std::min(x0 + 1, TRANSMITTANCE_W - 1), y1 = std::min(y0 + 1, TRANSMITTANCE_H - 1);
+		float fx = x - x0, fy = y - y0;
+
+		const float * t00 = transmittance + 3 * (y0 * TRANSMITTANCE_W + x0);
+		const float * t10 = transmittance + 3 * (y0 * TRANSMITTANCE_W + x1);
+		const float * t01 = transmittance + 3 * (y1 * TRANSMITTANCE_W + x0);
+		const float * t11 = transmittance + 3 * (y1 * TRANSMITTANCE_W + x1);
+		glm::vec3 result;
+		for (int c = 0; c < 3; c++) {
+			result[c] = (t00[c] * (1.0f - fx) + t10[c] * fx) * (1.0f - fy) + (t01[c] * (1.0f - fx) + t11[c] * fx) * fy;
+		}
+		return result;
+	}
+
+	// transmittance between x and the point at distance d along (r, mu)
+	glm::vec3 transmittanceAt(float r, float mu, float d) const {
+		float r1 = std::sqrt(std::max(p.Rg * p.Rg, r * r + d * d + 2.0f * r * mu * d));
+		float mu1 = (r * mu + d) / r1;
+		glm::vec3 a, b;
+		if (mu > 0.0f) {
+			a = transmittanceAt(r, mu);
+			b = transmittanceAt(r1, mu1);
+		}
+		else {
+			a = transmittanceAt(r1, -mu1);
+			b = transmittanceAt(r, -mu);
+		}
+		glm::vec3 result;
+		for (int c = 0; c < 3; c++) {
+			result[c] = b[c] > 0.0f ? std::min(a[c] / b[c], 1.0f) : 0.0f;
+		}
+		return result;
+	}
+
+	// single scattered light reaching x from direction (mu, nu), without phase functions
+	void inscatter(float r, float mu, float muS, float nu, glm::vec3 & ray, glm::vec3 & mie) const {
+		ray = glm::vec3(0.0f);
+		mie = glm::vec3(0.0f);
+
+		float dx = limit(r, mu) / INSCATTER_INTEGRAL_SAMPLES;
+		glm::vec3 rayi, miei;
+		integrand(r, mu, muS, nu, 0.0f, rayi, miei);
+		for (int i = 1; i <= INSCATTER_INTEGRAL_SAMPLES; ++i) {
+			float xj = i * dx;
+			glm::vec3 rayj, miej;
+			integrand(r, mu, muS, nu, xj, rayj, miej);
+			ray += (rayi + rayj) * (0.5f * dx);
+			mie += (miei + miej) * (0.5f * dx);
+			rayi = rayj;
+			miei = miej;
+		}
+		ray = ray * betaR;
+		mie = mie * betaMSca;
+	}
+
+	void integrand(float r, float mu, float muS, float nu, float t, glm::vec3 & ray, glm::vec3 & mie) const {
+		ray = glm::vec3(0.0f);
+		mie = glm::vec3(0.0f);
+		float ri = std::sqrt(r * r + t * t + 2.0f * r * mu * t);
+		float muSi = (nu * t + muS * r) / ri;
+		ri = std::max(p.Rg, ri);
+		if (muSi >= -std::sqrt(std::max(0.0f, 1.0f - p.Rg * p.Rg / (ri * ri)))) {
+			glm::vec3 ti = transmittanceAt(r, mu, t) * transmittanceAt(ri, muSi);
+			ray = ti * std::exp(-(ri - p.Rg) / p.HR);
+			mie = ti * std::exp(-(ri - p.Rg) / p.HM);
+		}
+	}
+
+	static float phaseR(float mu) {
+		return (3.0f / (16.0f * PI)) * (1.0f + mu * mu);
+	}
+
+	float phaseM(float mu) const {
+		float g = p.mieG;
+		return 1.5f * 1.0f / (4.0f * PI) * (1.0f - g * g) * std::pow(1.0f + g * g - 2.0f * g * mu, -3.0f / 2.0f) * (1.0f + mu * mu) / (2.0f + g * g);
+	}
+};
+
+}
+
+void precomputeAtmosphere(const AtmosphereParams & params, bool withInscatter, AtmosphereTables & tables, ThreadPool & pool) {
+	TRACE_SCOPE("precomputeAtmosphere");
+	auto start = std::chrono::steady_clock::now();
+
+	Model m;
+	m.p = params;
+	m.betaR = glm::vec3(params.betaR[0], params.betaR[1], params.betaR[2]);
+	m.betaMSca = glm::vec3(params.betaMSca[0], params.betaMSca[1], params.betaMSca[2]);
+	m.betaMEx = glm::vec3(params.betaMEx[0], params.betaMEx[1], params.betaMEx[2]);
+
+	// Transmittance, one row per task
+	tables.transmittance.assign(TRANSMITTANCE_W * TRANSMITTANCE_H * 3, 0.0f);
+	float * T = tables.transmittance.data();
+	pool.parallelFor(0, TRANSMITTANCE_H, 1, [&m, T](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			float uR = (y + 0.5f) / TRANSMITTANCE_H;
+			float r = m.p.Rg + uR * uR * (m.p.Rt - m.p.Rg);
+			for (int x = 0; x < TRANSMITTANCE_W; x++) {
+				float uMu = (x + 0.5f) / TRANSMITTANCE_W;
+				float mu = -0.15f + std::tan(1.5f * uMu) / std::tan(1.5f) * (1.0f + 0.15f);
+				float depthR = m.opticalDepth(m.p.HR, r, mu);
+				float depthM = m.opticalDepth(m.p.HM, r, mu);
+				for (int c = 0; c < 3; c++) {
+					T[3 * (y * TRANSMITTANCE_W + x) + c] = std::exp(-(m.betaR[c] * depthR + m.betaMEx[c] * depthM));
+				}
+			}
+		}
+	});
+	m.transmittance = T;
+
+	// Sky irradiance on the ground from single scattered light, integrated over the hemisphere
+	tables.irradiance.assign(SKY_W * SKY_H * 3, 0.0f);
+	float * E = tables.irradiance.data();
+	pool.parallelFor(0, SKY_W * SKY_H, 16, [&m, E](int i0, int i1) {
+		const float dtheta = 0.5f * PI / IRRADIANCE_INTEGRAL_THETA;
+		const float dphi = PI / IRRADIANCE_INTEGRAL_PHI;
+		for (int i = i0; i < i1; i++) {
+			int x = i % SKY_W, y = i / SKY_W;
+			float r = m.p.Rg + y / (SKY_H - 1.0f) * (m.p.Rt - m.p.Rg);
+			float muS = -0.2f + x / (SKY_W - 1.0f) * (1.0f + 0.2f);
+			glm::vec3 s(std::sqrt(std::max(0.0f, 1.0f - muS * muS)), 0.0f, muS);
+
+			glm::vec3 result(0.0f);
+			for (int iphi = 0; iphi < IRRADIANCE_INTEGRAL_PHI; iphi++) {
+				float phi = (iphi + 0.5f) * dphi;
+				for (int itheta = 0; itheta < IRRADIANCE_INTEGRAL_THETA; itheta++) {
+					float theta = (itheta + 0.5f) * dtheta;
+					glm::vec3 w(std::cos(phi) * std::sin(theta), std::sin(phi) * std::sin(theta), std::cos(theta));
+					float nu = glm::dot(s, w);
+					glm::vec3 ray, mie;
+					m.inscatter(r, w.z, muS, nu, ray, mie);
+					result += (ray * Model::phaseR(nu) + mie * m.phaseM(nu)) * (2.0f * w.z * std::sin(theta) * dtheta * dphi);
+				}
+			}
+			for (int c = 0; c < 3; c++) {
+				E[3 * i + c] = result[c];
+			}
+		}
+	});
+
+	// 4D single scattering table, laid out as in Bruneton's inscatter texture
+	if (withInscatter) {
+		tables.inscatter.assign(RES_MU_S * RES_NU * RES_MU * RES_R * 4, 0.0f);
+		float * S = tables.inscatter.data();
+		pool.parallelFor(0, RES_R * RES_MU, 4, [&m, S](int i0, int i1) {
+			const AtmosphereParams & p = m.p;
+			for (int i = i0; i < i1; i++) {
+				int layer = i / RES_MU, y = i % RES_MU;
+
+				float rr = layer / (RES_R - 1.0f);
+				rr = std::sqrt(p.Rg * p.Rg + rr * rr * (p.Rt * p.Rt - p.Rg * p.Rg)) + (layer == 0 ? 0.01f : (layer == RES_R - 1 ? -0.001f : 0.0f));
+				float dmin = p.Rt - rr;
+				float dmax = std::sqrt(rr * rr - p.Rg * p.Rg) + std::sqrt(p.Rt * p.Rt - p.Rg * p.Rg);
+				float dminp = rr - p.Rg;
+				float dmaxp = std::sqrt(rr * rr - p.Rg * p.Rg);
+
+				float mu;
+				if (y < RES_MU / 2) {
+					float d = 1.0f - y / (RES_MU / 2.0f - 1.0f);
+					d = std::min(std::max(dminp, d * dmaxp), dmaxp * 0.999f);
+					mu = (p.Rg * p.Rg - rr * rr - d * d) / (2.0f * rr * d);
+					mu = std::min(mu, -std::sqrt(1.0f - (p.Rg / rr) * (p.Rg / rr)) - 0.001f);
+				}
+				else {
+					float d = (y - RES_MU / 2.0f) / (RES_MU / 2.0f - 1.0f);
+					d = std::min(std::max(dmin, d * dmax), dmax * 0.999f);
+					mu = (p.Rt * p.Rt - rr * rr - d * d) / (2.0f * rr * d);
+				}
+
+				for (int x = 0; x < RES_MU_S * RES_NU; x++) {
+					float muS = (x % RES_MU_S) / (RES_MU_S - 1.0f);
+					muS = std::tan((2.0f * muS - 1.0f + 0.26f) * 1.1f) / std::tan(1.26f * 1.1f);
+					float nu = -1.0f + (x / RES_MU_S) / (RES_NU - 1.0f) * 2.0f;
+					float bound = std::sqrt(std::max(0.0f, (1.0f - mu * mu) * (1.0f - muS * muS)));
+					nu = glm::clamp(nu, muS * mu - bound, muS * mu + bound);
+
+					glm::vec3 ray, mie;
+					m.inscatter(rr, mu, muS, nu, ray, mie);
+					float * out = S + 4 * ((layer * RES_MU + y) * RES_MU_S * RES_NU + x);
+					out[0] = ray.x;
+					out[1] = ray.y;
+					out[2] = ray.z;
+					out[3] = mie.x;
+				}
+			}
+		});
+	}
+	else {
+		tables.inscatter.clear();
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Atmosphere precomputed in %.1f ms on %u threads\n", ms, pool.size() + 1);
+}
+
+bool loadAtmosphere(const AtmosphereParams & params, GLuint transmittanceTexture, GLuint irradianceTexture, bool withInscatter) {
+	char transmittancePath[64], irradiancePath[64], inscatterPath[64];
+	uint32_t key = atmosphereKey(params);
+	snprintf(transmittancePath, sizeof(transmittancePath), "atmosphere_%08x_transmittance.tbl", key);
+	snprintf(irradiancePath, sizeof(irradiancePath), "atmosphere_%08x_irradiance.tbl", key);
+	snprintf(inscatterPath, sizeof(inscatterPath), "atmosphere_%08x_inscatter.tbl", key);
+
+	// cache hit, no precomputation at all
+	if (loadTableTexture(transmittanceTexture, transmittancePath, NULL, TRANSMITTANCE_W, TRANSMITTANCE_H, 3) &&
+		loadTableTexture(irradianceTexture, irradiancePath, NULL, SKY_W, SKY_H, 3)) {
+		return true;
+	}
+
+	AtmosphereTables tables;
+	precomputeAtmosphere(params, withInscatter, tables, ThreadPool::shared());
+
+	bool cached = writeTable(transmittancePath, TRANSMITTANCE_W, TRANSMITTANCE_H, 3, tables.transmittance.data()) &&
+		writeTable(irradiancePath, SKY_W, SKY_H, 3, tables.irradiance.data());
+	if (withInscatter) {
+		cached = writeTable(inscatterPath, RES_MU_S * RES_NU, RES_MU, RES_R, 4, tables.inscatter.data()) && cached;
+	}
+	if (!cached) {
+		printf("Atmosphere tables could not be cached\n");
+	}
+
+	// upload from the half floats, as a cache hit would
+	std::vector<uint16_t> halfs(tables.transmittance.size());
+	for (size_t i = 0; i < halfs.size(); i++) halfs[i] = floatToHalf(tables.transmittance[i]);
+	uploadTable(transmittanceTexture, TRANSMITTANCE_W, TRANSMITTANCE_H, 3, halfs.data());
+
+	halfs.resize(tables.irradiance.size());
+	for (size_t i = 0; i < halfs.size(); i++) halfs[i] = floatToHalf(tables.irradiance[i]);
+	uploadTable(irradianceTexture, SKY_W, SKY_H, 3, halfs.data());
+
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef __ATMOSPHERE_H__
+#define __ATMOSPHERE_H__
+
+#include <GL/glew.h>
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+
+// Table sizes, they must match the lookups in waves.fs.glsl
+#define TRANSMITTANCE_W 256
+#define TRANSMITTANCE_H 64
+#define SKY_W 64
+#define SKY_H 16
+#define RES_R 32
+#define RES_MU 128
+#define RES_MU_S 32
+#define RES_NU 8
+
+// Physical model of the atmosphere, in meters (see Bruneton & Neyret 2008)
+struct AtmosphereParams {
+	float Rg;           // ground radius
+	float Rt;           // top of atmosphere radius
+	float RL;           // limit radius used for ray lengths
+	float HR;           // Rayleigh scale height
+	float betaR[3];     // Rayleigh scattering coefficients
+	float HM;           // Mie scale height
+	float betaMSca[3];  // Mie scattering coefficients
+	float betaMEx[3];   // Mie extinction coefficients
+	float mieG;         // Mie phase function asymmetry
+};
+
+// The atmosphere the shipped tables were computed with
+AtmosphereParams defaultAtmosphere();
+
+// Scales the Mie (aerosol) coefficients, i.e. haze. 1 is the default atmosphere,
+// visibility in km is roughly 3.9 / (betaMEx + betaR.g) at sea level.
+AtmosphereParams hazyAtmosphere(float haze);
+
+struct AtmosphereTables {
+	std::vector<float> transmittance; // TRANSMITTANCE_W x TRANSMITTANCE_H x RGB
+	std::vector<float> irradiance;    // SKY_W x SKY_H x RGB, sky light only (no direct sun)
+	std::vector<float> inscatter;     // (RES_MU_S * RES_NU) x RES_MU x RES_R x RGBA (Rayleigh rgb, Mie r), optional
+};
+
+// Precomputes the tables with single scattering, parallelised over texels.
+void precomputeAtmosphere(const AtmosphereParams & params, bool withInscatter, AtmosphereTables & tables, ThreadPool & pool);
+
+// Hash of the parameters, used to name the cached tables
+uint32_t atmosphereKey(const AtmosphereParams & params);
+
+// Uploads the transmittance and sky irradiance tables for params, loading them from
+// the disk cache when present and precomputing (and caching) them otherwise.
+bool loadAtmosphere(const AtmosphereParams & params, GLuint transmittanceTexture, GLuint irradianceTexture, bool withInscatter = false);
+
+#endif __ATMOSPHERE_H__
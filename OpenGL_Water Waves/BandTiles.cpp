@@ -0,0 +1,59 @@
+#include "stdafx.h"
+#include "BandTiles.h"
+
+BandTiles::BandTiles()
+	: texture{ 0 }, program{ 0 }, w{ 0 }, h{ 0 }, tilesX{ 0 }, tilesY{ 0 }, enabled{ false } {}
+
+BandTiles::~BandTiles() {
+	destroy();
+}
+
+void BandTiles::create(int width, int height) {
+	destroy();
+
+	int tw = (width + BAND_TILE_SIZE - 1) / BAND_TILE_SIZE;
+	int th = (height + BAND_TILE_SIZE - 1) / BAND_TILE_SIZE;
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, tw, th, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	w = tw;
+	h = th;
+}
+
+void BandTiles::destroy() {
+	if (texture != 0) glDeleteTextures(1, &texture);
+	texture = 0;
+	w = h = 0;
+}
+
+void BandTiles::compute(int renderWidth, int renderHeight) {
+	tilesX = (renderWidth + BAND_TILE_SIZE - 1) / BAND_TILE_SIZE;
+	tilesY = (renderHeight + BAND_TILE_SIZE - 1) / BAND_TILE_SIZE;
+
+	glUseProgram(program);
+	glUniform2i(glGetUniformLocation(program, "renderSize"), renderWidth, renderHeight);
+	glUniform1i(glGetUniformLocation(program, "tileSize"), BAND_TILE_SIZE);
+	glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8UI);
+
+	// one work group per tile
+	glDispatchCompute(tilesX, tilesY, 1);
+
+	// the ocean fragments fetch what the image stores wrote
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void BandTiles::setOceanUniforms(GLuint ocean) {
+	glActiveTexture(GL_TEXTURE0 + BAND_TILES_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(glGetUniformLocation(ocean, "bandTiles"), 1);
+	glUniform1i(glGetUniformLocation(ocean, "bandTileSize"), BAND_TILE_SIZE);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef __BAND_TILES_H__
+#define __BAND_TILES_H__
+
+#include <GL/glew.h>
+
+// Pixels per side of a tile
+#define BAND_TILE_SIZE 16
+
+// Texture unit the ocean programs read the tile bounds from, after the ocean
+// G-buffer's
+#define BAND_TILES_TEXTURE_UNIT 13
+
+// Per tile loop bounds of the ocean band loop. Before the ocean is drawn, the
+// band_tiles.cs.glsl pre-pass finds for each screen tile the range of wave
+// bands its fragments would refine, from the lod of the projected grid, and
+// writes the first band and the band count into a small RGBA8UI texture. The
+// range holds those of grid vertices the waves move into the tile from up to
+// the sum of their amplitudes away, so it is wider than a single fragment's;
+// the bands it adds have no weight there.
+//
+// Fragments then loop over their tile's range: every fragment of a tile runs
+// the same iterations, and tiles without a band skip the loop and the G-buffer
+// upsample altogether, near the horizon where every wave is shorter than a
+// pixel.
+//
+// The texture is allocated for the framebuffer size, scaled frames use a corner.
+class BandTiles {
+private:
+	GLuint texture;
+	GLuint program;
+	int w, h; // tiles
+	int tilesX, tilesY; // used by the current frame
+	bool enabled;
+
+public:
+	BandTiles();
+	~BandTiles();
+
+	BandTiles(const BandTiles &) = delete;
+	BandTiles & operator=(const BandTiles &) = delete;
+
+	// Allocates the tiles of a width x height framebuffer
+	void create(int width, int height);
+	void destroy();
+
+	void setShader(GLuint program) { this->program = program; }
+	GLuint getShader() const { return program; }
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+	bool isEnabled() const { return enabled; }
+
+	// Whether the tiles match a width x height framebuffer
+	bool fits(int width, int height) const { return texture != 0 && (width + BAND_TILE_SIZE - 1) / BAND_TILE_SIZE == w && (height + BAND_TILE_SIZE - 1) / BAND_TILE_SIZE == h; }
+
+	// Runs the pre-pass over a renderWidth x renderHeight view. The caller sets
+	// the camera and wave uniforms of the program, they match the ocean's.
+	void compute(int renderWidth, int renderHeight);
+
+	// Binds the tile bounds for the ocean lighting program
+	void setOceanUniforms(GLuint ocean);
+};
+
+#endif __BAND_TILES_H__
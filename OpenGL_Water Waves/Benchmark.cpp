@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+	struct Axis {
+		std::vector<std::pair<int, int>> resolutions;
+		std::vector<float> gridSizes, waves, thetas, heights, normals, reflactances, irradiances;
+	};
+
+	std::vector<float> numbers(std::istringstream & in) {
+		std::vector<float> values;
+		float v;
+		while (in >> v) values.push_back(v);
+		return values;
+	}
+
+	// Value of "key": in a line written by writeBenchJson
+	double jsonNumber(const std::string & line, const char * key, double fallback) {
+		std::string pattern = std::string("\"") + key + "\":";
+		size_t at = line.find(pattern);
+		if (at == std::string::npos) return fallback;
+		return atof(line.c_str() + at + pattern.size());
+	}
+
+	std::string jsonString(const std::string & line, const char * key) {
+		std::string pattern = std::string("\"") + key + "\":\"";
+		size_t at = line.find(pattern);
+		if (at == std::string::npos) return "";
+		size_t begin = at + pattern.size();
+		size_t end = line.find('"', begin);
+		return end == std::string::npos ? "" : line.substr(begin, end - begin);
+	}
+
+	const BenchResult * findResult(const std::vector<BenchResult> & results, const std::string & name) {
+		for (const BenchResult & r : results) {
+			if (r.name == name) return &r;
+		}
+		return NULL;
+	}
+
+	double growth(double before, double after) {
+		return before > 0.0 ? (after - before) / before * 100.0 : 0.0;
+	}
+}
+
+std::string BenchScenario::name() const {
+	char text[128];
+	snprintf(text, sizeof(text), "%dx%d_grid%d_waves%d_theta%g_h%g_n%dr%di%d",
+		width, height, gridSize, waves, theta, cameraHeight, normals, reflactance, irradiance);
+	return text;
+}
+
+bool loadBenchMatrix(const char * path, std::vector<BenchScenario> & scenarios) {
+	Axis axis;
+
+	if (path == NULL) {
+		axis.resolutions = { { 1280, 720 }, { 1920, 1080 } };
+		axis.gridSizes = { 4, 8 };
+		axis.waves = { 30, 60 };
+		axis.thetas = { 0, 20 };
+	}
+	else {
+		std::ifstream file(path);
+		if (!file) {
+			printf("Benchmark matrix %s could not be opened\n", path);
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(file, line)) {
+			size_t colon = line.find(':');
+			if (line.empty() || line[0] == '#' || colon == std::string::npos) continue;
+			std::string key = line.substr(0, colon);
+			std::istringstream values(line.substr(colon + 1));
+
+			if (key == "resolution") {
+				std::string size;
+				while (values >> size) {
+					int w, h;
+					if (sscanf(size.c_str(), "%dx%d", &w, &h) == 2) axis.resolutions.push_back(std::make_pair(w, h));
+				}
+			}
+			else if (key == "gridSize") axis.gridSizes = numbers(values);
+			else if (key == "waves") axis.waves = numbers(values);
+			else if (key == "theta") axis.thetas = numbers(values);
+			else if (key == "height") axis.heights = numbers(values);
+			else if (key == "normals") axis.normals = numbers(values);
+			else if (key == "reflactance") axis.reflactances = numbers(values);
+			else if (key == "irradiance") axis.irradiances = numbers(values);
+			else printf("Benchmark matrix %s: unknown key %s\n", path, key.c_str());
+		}
+	}
+
+	// defaults match the interactive start up state
+	if (axis.resolutions.empty()) axis.resolutions = { { 1280, 720 } };
+	if (axis.gridSizes.empty()) axis.gridSizes = { 8 };
+	if (axis.waves.empty()) axis.waves = { 60 };
+	if (axis.thetas.empty()) axis.thetas = { 0 };
+	if (axis.heights.empty()) axis.heights = { 10 };
+	if (axis.normals.empty()) axis.normals = { 0 };
+	if (axis.reflactances.empty()) axis.reflactances = { 0 };
+	if (axis.irradiances.empty()) axis.irradiances = { 1 };
+
+	// the spectrum spreads its wavelengths over waves - 1 steps
+	for (size_t i = 0; i < axis.waves.size(); ) {
+		if (axis.waves[i] < 2.0f) {
+			printf("Benchmark matrix %s: waves %g skipped, at least 2 are needed\n", path != NULL ? path : "(default)", axis.waves[i]);
+			axis.waves.erase(axis.waves.begin() + i);
+		}
+		else i++;
+	}
+
+	for (const std::pair<int, int> & resolution : axis.resolutions)
+	for (float gridSize : axis.gridSizes)
+	for (float waves : axis.waves)
+	for (float theta : axis.thetas)
+	for (float height : axis.heights)
+	for (float normals : axis.normals)
+	for (float reflactance : axis.reflactances)
+	for (float irradiance : axis.irradiances) {
+		BenchScenario s;
+		s.width = resolution.first;
+		s.height = resolution.second;
+		s.gridSize = (int)gridSize;
+		s.waves = (int)waves;
+		s.theta = theta;
+		s.cameraHeight = height;
+		s.normals = normals != 0.0f;
+		s.reflactance = reflactance != 0.0f;
+		s.irradiance = irradiance != 0.0f;
+		scenarios.push_back(s);
+	}
+	return true;
+}
+
+double percentile(std::vector<double> & samples, double p) {
+	if (samples.empty()) return 0.0;
+	std::sort(samples.begin(), samples.end());
+	size_t rank = (size_t)std::ceil(p / 100.0 * samples.size());
+	return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+}
+
+bool writeBenchJson(const char * path, const std::vector<BenchResult> & results) {
+	FILE * file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Benchmark results %s could not be opened\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\"results\":[\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult & r = results[i];
+		const BenchScenario & s = r.scenario;
+		fprintf(file,
+			"{\"name\":\"%s\",\"width\":%d,\"height\":%d,\"gridSize\":%d,\"waves\":%d,\"theta\":%g,\"cameraHeight\":%g,"
+			"\"normals\":%d,\"reflactance\":%d,\"irradiance\":%d,\"frames\":%d,"
+			"\"ms_mean\":%.4f,\"ms_p50\":%.4f,\"ms_p90\":%.4f,\"ms_p99\":%.4f,\"ms_max\":%.4f,"
+			"\"gpu_ocean_ms\":%.4f,\"gpu_skybox_ms\":%.4f,\"vertex_invocations\":%.0f,\"fragment_invocations\":%.0f}%s\n",
+			r.name.c_str(), s.width, s.height, s.gridSize, s.waves, s.theta, s.cameraHeight,
+			s.normals, s.reflactance, s.irradiance, r.frames,
+			r.msMean, r.msP50, r.msP90, r.msP99, r.msMax,
+			r.gpuOceanMs, r.gpuSkyboxMs, r.vertexInvocations, r.fragmentInvocations,
+			i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "]}\n");
+
+	bool ok = fclose(file) == 0;
+	if (!ok) printf("Benchmark results %s could not be written\n", path);
+	return ok;
+}
+
+bool readBenchJson(const char * path, std::vector<BenchResult> & results) {
+	std::ifstream file(path);
+	if (!file) {
+		printf("Benchmark results %s could not be opened\n", path);
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::string name = jsonString(line, "name");
+		if (name.empty()) continue;
+
+		BenchResult r;
+		r.name = name;
+		r.scenario.width = (int)jsonNumber(line, "width", 0);
+		r.scenario.height = (int)jsonNumber(line, "height", 0);
+		r.scenario.gridSize = (int)jsonNumber(line, "gridSize", 0);
+		r.scenario.waves = (int)jsonNumber(line, "waves", 0);
+		r.scenario.theta = (float)jsonNumber(line, "theta", 0);
+		r.scenario.cameraHeight = (float)jsonNumber(line, "cameraHeight", 0);
+		r.scenario.normals = jsonNumber(line, "normals", 0) != 0.0;
+		r.scenario.reflactance = jsonNumber(line, "reflactance", 0) != 0.0;
+		r.scenario.irradiance = jsonNumber(line, "irradiance", 0) != 0.0;
+		r.frames = (int)jsonNumber(line, "frames", 0);
+		r.msMean = jsonNumber(line, "ms_mean", 0);
+		r.msP50 = jsonNumber(line, "ms_p50", 0);
+		r.msP90 = jsonNumber(line, "ms_p90", 0);
+		r.msP99 = jsonNumber(line, "ms_p99", 0);
+		r.msMax = jsonNumber(line, "ms_max", 0);
+		r.gpuOceanMs = jsonNumber(line, "gpu_ocean_ms", 0);
+		r.gpuSkyboxMs = jsonNumber(line, "gpu_skybox_ms", 0);
+		r.vertexInvocations = jsonNumber(line, "vertex_invocations", -1);
+		r.fragmentInvocations = jsonNumber(line, "fragment_invocations", -1);
+		results.push_back(r);
+	}
+	return true;
+}
+
+int compareBench(const std::vector<BenchResult> & baseline, const std::vector<BenchResult> & current, double thresholdPercent) {
+	int regressions = 0;
+
+	printf("%-52s %10s %10s %8s %10s %8s %10s %8s\n", "scenario", "p50 ms", "base", "diff", "p90 ms", "diff", "ocean ms", "diff");
+	for (const BenchResult & r : current) {
+		const BenchResult * base = findResult(baseline, r.name);
+		if (base == NULL) {
+			printf("%-52s %10.3f %10s (new)\n", r.name.c_str(), r.msP50, "-");
+			continue;
+		}
+
+		double p50 = growth(base->msP50, r.msP50);
+		double p90 = growth(base->msP90, r.msP90);
+		double ocean = growth(base->gpuOceanMs, r.gpuOceanMs);
+		bool regressed = p50 > thresholdPercent || p90 > thresholdPercent || ocean > thresholdPercent;
+		if (regressed) regressions++;
+
+		printf("%-52s %10.3f %10.3f %+7.1f%% %10.3f %+7.1f%% %10.3f %+7.1f%%%s\n",
+			r.name.c_str(), r.msP50, base->msP50, p50, r.msP90, p90, r.gpuOceanMs, ocean, regressed ? "  REGRESSION" : "");
+	}
+	for (const BenchResult & b : baseline) {
+		if (findResult(current, b.name) == NULL) printf("%-52s missing from the current run\n", b.name.c_str());
+	}
+
+	printf("%d of %d scenarios regressed by more than %.1f%%\n", regressions, (int)current.size(), thresholdPercent);
+	return regressions;
+}
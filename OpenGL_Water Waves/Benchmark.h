@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <string>
+#include <vector>
+
+// One point of the benchmark matrix
+struct BenchScenario {
+	int width;
+	int height;
+	int gridSize;
+	int waves;
+	float theta;        // camera pitch in degrees
+	float cameraHeight;
+	bool normals;
+	bool reflactance;
+	bool irradiance;
+
+	// Stable key used to match scenarios between runs
+	std::string name() const;
+};
+
+struct BenchResult {
+	BenchScenario scenario;
+	std::string name;
+	int frames;
+	double msMean, msP50, msP90, msP99, msMax;   // frame time to glFinish
+	double gpuOceanMs, gpuSkyboxMs;              // GL_TIME_ELAPSED means
+	double vertexInvocations, fragmentInvocations; // one frame, -1 if unsupported
+};
+
+// Cartesian product of the values listed per key, one key per line:
+//   resolution: 1280x720 1920x1080
+//   gridSize: 4 8 16
+//   waves: 30 60
+//   theta: 0 20
+//   height: 10 50
+//   normals: 0
+//   reflactance: 0 1
+//   irradiance: 1
+// Keys left out keep a single default value. An empty path gives the default matrix.
+bool loadBenchMatrix(const char * path, std::vector<BenchScenario> & scenarios);
+
+// Nearest rank percentile, sorts samples
+double percentile(std::vector<double> & samples, double p);
+
+// One result object per line, so readBenchJson can stay a line scanner
+bool writeBenchJson(const char * path, const std::vector<BenchResult> & results);
+bool readBenchJson(const char * path, std::vector<BenchResult> & results);
+
+// Prints a table of current against baseline and returns the number of scenarios
+// whose p50 or p90 frame time or GPU ocean time grew by more than thresholdPercent
+int compareBench(const std::vector<BenchResult> & baseline, const std::vector<BenchResult> & current, double thresholdPercent);
+
+#endif __BENCHMARK_H__
@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(double targetMs, int baseGrid, float minScale, float maxScale, int maxGrid)
+	: targetMs{ targetMs }, minScale{ minScale }, maxScale{ maxScale }, baseGrid{ baseGrid }, maxGrid{ std::max(maxGrid, baseGrid) },
+	scale{ maxScale }, grid{ baseGrid }, filteredMs{ -1.0 }, settle{ DYNRES_SETTLE_FRAMES } {}
+
+bool DynamicResolution::update(double gpuMs) {
+	if (gpuMs <= 0.0) {
+		return false; // no timer queries, or nothing measured yet
+	}
+	if (settle > 0) {
+		settle--;
+		return false;
+	}
+	filteredMs = filteredMs < 0.0 ? gpuMs : filteredMs + (gpuMs - filteredMs) * 0.2;
+
+	float previousScale = scale;
+	int previousGrid = grid;
+	double ratio = targetMs / filteredMs;
+
+	// between 0.9 and 1.15 of the target nothing changes, so the scale does
+	// not hunt around the budget
+	if (ratio < 0.9) {
+		if (scale > minScale) {
+			// cost goes with the pixel count, the scale with its square root
+			scale = std::max(minScale, scale * (float)std::max(std::sqrt(ratio), 0.8));
+		}
+		else if (grid < maxGrid) {
+			grid++;
+		}
+	}
+	else if (ratio > 1.15) {
+		if (grid > baseGrid) {
+			grid--;
+		}
+		else if (scale < maxScale) {
+			scale = std::min(maxScale, scale * (float)std::min(std::sqrt(ratio), 1.1));
+		}
+	}
+
+	// steps of 1/64, a change worth the settling frames
+	scale = std::min(std::max(std::round(scale * 64.0f) / 64.0f, minScale), maxScale);
+	if (scale == previousScale && grid == previousGrid) {
+		return false;
+	}
+
+	settle = DYNRES_SETTLE_FRAMES;
+	filteredMs = -1.0;
+	return true;
+}
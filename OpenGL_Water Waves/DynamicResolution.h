@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef __DYNAMIC_RESOLUTION_H__
+#define __DYNAMIC_RESOLUTION_H__
+
+#include "GpuProfiler.h"
+
+#define DYNRES_TARGET_MS 12.0   // GPU budget of the ocean and sky passes
+#define DYNRES_MIN_SCALE 0.5f   // of the framebuffer size, per axis
+#define DYNRES_MAX_SCALE 1.0f
+#define DYNRES_MAX_GRID 16      // coarsest grid cell, in pixels
+// Timings come back GPU_PROFILER_FRAMES late, the frames after a change
+// still show the old cost
+#define DYNRES_SETTLE_FRAMES (GPU_PROFILER_FRAMES + 2)
+
+// Holds the ocean passes to a GPU time budget. Fragment cost follows the
+// render scale squared, the fragment wave loop runs once per pixel; vertex
+// cost follows the grid density, the vertex wave loop runs once per grid
+// vertex. Over budget the scale goes down first and the grid only coarsens
+// once the scale is at its minimum; with headroom the grid comes back first.
+class DynamicResolution {
+private:
+	double targetMs;
+	float minScale, maxScale;
+	int baseGrid, maxGrid;
+
+	float scale;
+	int grid;
+	double filteredMs; // smoothed timing, negative until the first sample
+	int settle;        // frames to ignore after a change
+
+public:
+	DynamicResolution(double targetMs, int baseGrid, float minScale = DYNRES_MIN_SCALE, float maxScale = DYNRES_MAX_SCALE, int maxGrid = DYNRES_MAX_GRID);
+
+	// Feeds the GPU time of the last collected frame, once per frame. True
+	// when the scale or the grid changed.
+	bool update(double gpuMs);
+
+	float getScale() const { return scale; }
+	int getGridSize() const { return grid; }
+	double getTargetMs() const { return targetMs; }
+	double getFilteredMs() const { return filteredMs; }
+};
+
+#endif __DYNAMIC_RESOLUTION_H__
@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "FrameCapture.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+	double msSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+FrameCapture::FrameCapture() : next{ 0 }, imageFormat{ ImagePPM }, w{ 0 }, h{ 0 }, frameSize{ 0 }, pool{ NULL },
+	captured{ 0 }, written{ 0 }, failed{ 0 }, gpuWaits{ 0 }, encoderWaits{ 0 }, gpuWaitMs{ 0.0 }, encoderWaitMs{ 0.0 }, encodeMs{ 0.0 } {
+	memset(slots, 0, sizeof(slots));
+}
+
+FrameCapture::~FrameCapture() {
+	close();
+}
+
+bool FrameCapture::expandPattern(const char * pattern, long frame, long view, std::string & path) {
+	long values[2] = { frame, view };
+	int used = 0;
+
+	path.clear();
+	for (const char * c = pattern; *c != '\0'; c++) {
+		if (*c != '%') {
+			path += *c;
+			continue;
+		}
+		c++;
+		if (*c == '%') {
+			path += '%';
+			continue;
+		}
+
+		bool zero = *c == '0';
+		if (zero) c++;
+		int width = 0;
+		while (*c >= '0' && *c <= '9' && width < 100) width = width * 10 + (*c++ - '0');
+		if (*c == 'l') c++;
+		if ((*c != 'd' && *c != 'i' && *c != 'u') || width > 20 || used == 2) {
+			return false;
+		}
+
+		char number[32];
+		snprintf(number, sizeof(number), zero ? "%0*ld" : "%*ld", width, values[used++]);
+		path += number;
+	}
+	return true;
+}
+
+bool FrameCapture::open(const char * path, int width, int height, ThreadPool & threads) {
+	close();
+
+	std::string test;
+	if (!expandPattern(path, 0, 0, test)) {
+		printf("Capture pattern %s: only %%d style frame and view numbers are supported\n", path);
+		return false;
+	}
+
+	pattern = path;
+	imageFormat = imageFormatFromPath(path);
+	w = width;
+	h = height;
+	frameSize = (size_t)width * height * imagePixelSize(imageFormat);
+
+	for (int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+		glGenBuffers(1, &slots[i].pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+		slots[i].fence = NULL;
+		slots[i].frame = -1;
+		slots[i].view = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	int count = (int)threads.size() + 1;
+	buffers.resize(count);
+	freeBuffers.clear();
+	for (int i = 0; i < count; i++) {
+		buffers[i].resize(frameSize);
+		freeBuffers.push_back(i);
+	}
+
+	captured = written = failed = 0;
+	gpuWaits = encoderWaits = 0;
+	gpuWaitMs = encoderWaitMs = encodeMs = 0.0;
+	next = 0;
+	pool = &threads;
+	return true;
+}
+
+int FrameCapture::acquireBuffer() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (freeBuffers.empty()) {
+		TRACE_SCOPE("capture encoder wait");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		returned.wait(lock, [this] { return !freeBuffers.empty(); });
+		encoderWaits++;
+		encoderWaitMs += msSince(start);
+	}
+	int index = freeBuffers.back();
+	freeBuffers.pop_back();
+	return index;
+}
+
+bool FrameCapture::retire(Slot & slot, bool block) {
+	if (slot.fence == NULL) return true;
+
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		if (!block) return false;
+
+		TRACE_SCOPE("capture gpu wait");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		do {
+			status = glClientWaitSync(slot.fence, 0, 1000000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		gpuWaits++;
+		gpuWaitMs += msSince(start);
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = NULL;
+
+	TRACE_SCOPE("capture copy");
+	int index = acquireBuffer();
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	const void * mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+	if (mapped == NULL) {
+		// nothing was read, the frame is counted as failed rather than written blank
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		printf("Frame %ld view %ld could not be read back\n", slot.frame, slot.view);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		freeBuffers.push_back(index);
+		failed++;
+		return true;
+	}
+	memcpy(&buffers[index][0], mapped, frameSize);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	std::string file;
+	expandPattern(pattern.c_str(), slot.frame, slot.view, file);
+
+	pool->submit([this, index, file] {
+		TRACE_SCOPE("capture encode");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool ok = writeImage(file.c_str(), imageFormat, w, h, &buffers[index][0], true);
+		double ms = msSince(start);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (ok) written++;
+		else failed++;
+		encodeMs += ms;
+		freeBuffers.push_back(index);
+		returned.notify_one();
+	});
+	return true;
+}
+
+void FrameCapture::capture(long frame, long view) {
+	if (pool == NULL) return;
+	TRACE_SCOPE("capture");
+
+	// frames that finished since the last call, oldest first
+	for (int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+		if (!retire(slots[(next + i) % FRAME_CAPTURE_SLOTS], false)) break;
+	}
+
+	// the slot about to be reused has to be free even if its frame is not done
+	Slot & slot = slots[next];
+	retire(slot, true);
+
+	GLint alignment;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	glReadPixels(0, 0, w, h, GL_RGBA, imageFormat == ImageEXR ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = frame;
+	slot.view = view;
+	next = (next + 1) % FRAME_CAPTURE_SLOTS;
+	captured++;
+}
+
+void FrameCapture::close() {
+	if (pool == NULL) return;
+
+	for (int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+		retire(slots[(next + i) % FRAME_CAPTURE_SLOTS], true);
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		returned.wait(lock, [this] { return freeBuffers.size() == buffers.size(); });
+	}
+
+	for (int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+		glDeleteBuffers(1, &slots[i].pbo);
+		slots[i].pbo = 0;
+	}
+	buffers.clear();
+	freeBuffers.clear();
+	pool = NULL;
+}
+
+std::string FrameCapture::summary() {
+	std::lock_guard<std::mutex> lock(mutex);
+	char text[256];
+	snprintf(text, sizeof(text),
+		"Captured %ld frames, %ld written, %ld failed, encode %.2f ms/frame, waited on GPU %ld times (%.2f ms), on encoders %ld times (%.2f ms)\n",
+		captured, written, failed, written + failed > 0 ? encodeMs / (written + failed) : 0.0, gpuWaits, gpuWaitMs, encoderWaits, encoderWaitMs);
+	return text;
+}
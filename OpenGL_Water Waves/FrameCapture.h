@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef __FRAME_CAPTURE_H__
+#define __FRAME_CAPTURE_H__
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ImageWriter.h"
+
+class ThreadPool;
+
+// Pixel pack buffers in flight. A frame is mapped this many captures after its
+// glReadPixels, by which time the GPU has normally finished it.
+#define FRAME_CAPTURE_SLOTS 4
+
+// Asynchronous readback of rendered frames.
+//
+// capture() starts a glReadPixels into the next pixel pack buffer of a ring
+// and fences it, so it returns without waiting for the GPU. Finished buffers
+// are copied out and encoded on the thread pool. When the encoders fall behind,
+// capture() waits for one of them to return its buffer instead of queuing
+// frames without bound; when the GPU falls behind it waits on the oldest fence.
+class FrameCapture {
+private:
+	struct Slot {
+		GLuint pbo;
+		GLsync fence;
+		long frame;
+		long view;
+	};
+
+	Slot slots[FRAME_CAPTURE_SLOTS];
+	int next;
+
+	std::string pattern;
+	ImageFormat imageFormat;
+	int w, h;
+	size_t frameSize;
+	ThreadPool * pool;
+
+	// frames copied out of the ring and waiting for, or being, encoded
+	std::vector<std::vector<unsigned char>> buffers;
+	std::vector<int> freeBuffers;
+	std::mutex mutex;
+	std::condition_variable returned;
+
+	long captured;
+	long written;
+	long failed;
+	long gpuWaits;
+	long encoderWaits;
+	double gpuWaitMs;
+	double encoderWaitMs;
+	double encodeMs;
+
+	bool retire(Slot & slot, bool block);
+	int acquireBuffer();
+
+public:
+	FrameCapture();
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture &) = delete;
+	FrameCapture & operator=(const FrameCapture &) = delete;
+
+	// pattern takes the frame and view numbers in printf style, like
+	// "ocean_%05ld.png" or "view_%05ld_%02ld.png", its extension picks the
+	// format. Encoding runs on pool with up to pool.size() + 1 frames queued.
+	bool open(const char * pattern, int width, int height, ThreadPool & pool);
+
+	// Substitutes the numbers into pattern without handing it to printf. Only %%
+	// and at most two integer conversions with an optional 0 flag and width are
+	// accepted, false for anything else.
+	static bool expandPattern(const char * pattern, long frame, long view, std::string & path);
+
+	// Reads the bound read framebuffer. Returns as soon as the read is queued.
+	void capture(long frame, long view = 0);
+
+	// Writes every frame still in flight, then releases the buffers
+	void close();
+
+	bool isOpen() const { return pool != NULL; }
+	ImageFormat format() const { return imageFormat; }
+
+	// Frames written, time spent waiting on the GPU and on the encoders
+	std::string summary();
+};
+
+#endif __FRAME_CAPTURE_H__
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "GpuProfiler.h"
+#include <cstring>
+
+GpuProfiler::GpuProfiler() : slot{ 0 }, frame{ 0 }, open{ -1 }, ready{ false }, dropped{ 0 }, log{ NULL } {
+	memset(queries, 0, sizeof(queries));
+	memset(issued, 0, sizeof(issued));
+	for (int i = 0; i < GPU_PROFILER_FRAMES; i++) frameOfSlot[i] = -1;
+	for (int p = 0; p < NumGpuPasses; p++) {
+		lastMs[p] = 0.0;
+		averageMs[p] = 0.0;
+		totalMs[p] = 0.0;
+		samples[p] = 0;
+	}
+}
+
+GpuProfiler::~GpuProfiler() {
+	closeLog();
+}
+
+void GpuProfiler::init() {
+	glGenQueries(GPU_PROFILER_FRAMES * NumGpuPasses * GPU_PROFILER_QUERIES, &queries[0][0][0]);
+	frameOfSlot[slot] = frame;
+	ready = true;
+}
+
+const char * GpuProfiler::passName(GpuPass pass) {
+	switch (pass) {
+	case OceanPass:           return "ocean";
+	case SkyboxPass:          return "skybox";
+	case EnvironmentBakePass: return "env_bake";
+	case IrradianceBakePass:  return "irradiance_bake";
+	case TemporalResolvePass: return "temporal_resolve";
+	case OceanBandsPass:      return "ocean_bands";
+	case BandTilesPass:       return "band_tiles";
+	default:                  return "unknown";
+	}
+}
+
+void GpuProfiler::collect(int s) {
+	bool any = false;
+	double ms[NumGpuPasses];
+
+	for (int p = 0; p < NumGpuPasses; p++) {
+		ms[p] = -1.0;
+		if (issued[s][p] == 0) continue;
+
+		GLint available = 1;
+		for (int q = 0; q < issued[s][p] && available; q++) {
+			glGetQueryObjectiv(queries[s][p][q], GL_QUERY_RESULT_AVAILABLE, &available);
+		}
+		if (!available) {
+			// the GPU is more than GPU_PROFILER_FRAMES behind, drop the sample rather than wait
+			dropped++;
+		}
+		else {
+			GLuint64 ns = 0;
+			for (int q = 0; q < issued[s][p]; q++) {
+				GLuint64 run = 0;
+				glGetQueryObjectui64v(queries[s][p][q], GL_QUERY_RESULT, &run);
+				ns += run;
+			}
+			ms[p] = ns / 1.0e6;
+			lastMs[p] = ms[p];
+			averageMs[p] = samples[p] == 0 ? ms[p] : averageMs[p] * 0.95 + ms[p] * 0.05;
+			totalMs[p] += ms[p];
+			samples[p]++;
+			any = true;
+		}
+		issued[s][p] = 0;
+	}
+
+	if (any && log != NULL) {
+		fprintf(log, "%ld", frameOfSlot[s]);
+		for (int p = 0; p < NumGpuPasses; p++) {
+			if (ms[p] >= 0.0) fprintf(log, ",%.4f", ms[p]);
+			else fprintf(log, ",");
+		}
+		fprintf(log, "\n");
+	}
+}
+
+void GpuProfiler::beginFrame() {
+	if (!ready) return;
+
+	if (open >= 0) {
+		end((GpuPass)open);
+	}
+
+	// finished frames, oldest first, without blocking on the ones still in flight
+	for (int i = 1; i < GPU_PROFILER_FRAMES; i++) {
+		int s = (slot + i) % GPU_PROFILER_FRAMES;
+		bool pending = false;
+		for (int p = 0; p < NumGpuPasses; p++) pending = pending || issued[s][p] > 0;
+		if (!pending) continue;
+
+		GLint available = 1;
+		for (int p = 0; p < NumGpuPasses && available; p++) {
+			for (int q = 0; q < issued[s][p] && available; q++) {
+				glGetQueryObjectiv(queries[s][p][q], GL_QUERY_RESULT_AVAILABLE, &available);
+			}
+		}
+		if (available) collect(s);
+	}
+
+	frame++;
+	slot = (slot + 1) % GPU_PROFILER_FRAMES;
+
+	// the slot is about to be reused, whatever is still in it is lost
+	collect(slot);
+	frameOfSlot[slot] = frame;
+}
+
+void GpuProfiler::begin(GpuPass pass) {
+	if (!ready) return;
+	if (open >= 0) {
+		end((GpuPass)open); // GL_TIME_ELAPSED queries cannot nest
+	}
+	if (issued[slot][pass] == GPU_PROFILER_QUERIES) {
+		dropped++;
+		return;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[slot][pass][issued[slot][pass]]);
+	open = pass;
+}
+
+void GpuProfiler::end(GpuPass pass) {
+	if (!ready || open != pass) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	issued[slot][pass]++;
+	open = -1;
+}
+
+void GpuProfiler::flush() {
+	if (!ready) return;
+
+	if (open >= 0) {
+		end((GpuPass)open);
+	}
+	glFinish();
+
+	// oldest first, the current slot last
+	for (int i = 1; i <= GPU_PROFILER_FRAMES; i++) {
+		collect((slot + i) % GPU_PROFILER_FRAMES);
+	}
+}
+
+void GpuProfiler::reset() {
+	if (open >= 0) {
+		end((GpuPass)open);
+	}
+	memset(issued, 0, sizeof(issued));
+	for (int p = 0; p < NumGpuPasses; p++) {
+		lastMs[p] = 0.0;
+		averageMs[p] = 0.0;
+		totalMs[p] = 0.0;
+		samples[p] = 0;
+	}
+	dropped = 0;
+}
+
+bool GpuProfiler::openLog(const char * path) {
+	closeLog();
+	log = fopen(path, "w");
+	if (log == NULL) {
+		printf("GPU timing log %s could not be opened\n", path);
+		return false;
+	}
+	fprintf(log, "frame");
+	for (int p = 0; p < NumGpuPasses; p++) {
+		fprintf(log, ",%s_ms", passName((GpuPass)p));
+	}
+	fprintf(log, "\n");
+	return true;
+}
+
+void GpuProfiler::closeLog() {
+	if (log != NULL) {
+		fclose(log);
+		log = NULL;
+	}
+}
+
+std::string GpuProfiler::summary() const {
+	std::string text;
+	char line[96];
+	for (int p = 0; p < NumGpuPasses; p++) {
+		snprintf(line, sizeof(line), "%-16s %7.3f ms (avg %7.3f)\n", passName((GpuPass)p), lastMs[p], averageMs[p]);
+		text += line;
+	}
+	return text;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef __GPU_PROFILER_H__
+#define __GPU_PROFILER_H__
+
+#include <GL/glew.h>
+#include <cstdio>
+#include <string>
+
+enum GpuPass { OceanPass, SkyboxPass, EnvironmentBakePass, IrradianceBakePass, TemporalResolvePass, OceanBandsPass, BandTilesPass, NumGpuPasses };
+
+// Frames in flight. Results are read back this many frames late, when the GPU is
+// done with them, so reading never stalls the pipeline.
+#define GPU_PROFILER_FRAMES 4
+
+// Queries per pass and frame. A pass that runs more than once in a frame, once
+// per view, is timed as the sum of its runs; runs past this count are dropped.
+#define GPU_PROFILER_QUERIES 16
+
+// Per pass GL_TIME_ELAPSED timings
+class GpuProfiler {
+private:
+	GLuint queries[GPU_PROFILER_FRAMES][NumGpuPasses][GPU_PROFILER_QUERIES];
+	int issued[GPU_PROFILER_FRAMES][NumGpuPasses];  // queries ended in the frame
+	long frameOfSlot[GPU_PROFILER_FRAMES];
+
+	int slot;
+	long frame;
+	int open;        // pass whose query is running, -1 if none
+	bool ready;
+
+	double lastMs[NumGpuPasses];
+	double averageMs[NumGpuPasses];
+	double totalMs[NumGpuPasses];
+	long samples[NumGpuPasses];
+	long dropped;
+
+	FILE * log;
+
+	void collect(int s);
+
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	void init();
+
+	// Reads whatever finished frames are available and moves to the next slot
+	void beginFrame();
+
+	void begin(GpuPass pass);
+	void end(GpuPass pass);
+
+	// Waits for the GPU and collects every slot, the current frame included
+	void flush();
+
+	// Forgets the statistics and the frames still in flight, between benchmark runs
+	void reset();
+
+	double getMs(GpuPass pass) const { return lastMs[pass]; }
+	double getAverageMs(GpuPass pass) const { return averageMs[pass]; }
+	double getMeanMs(GpuPass pass) const { return samples[pass] > 0 ? totalMs[pass] / samples[pass] : 0.0; }
+	long getDropped() const { return dropped; }
+
+	static const char * passName(GpuPass pass);
+
+	// One line per collected frame: frame,<pass>_ms,...
+	bool openLog(const char * path);
+	void closeLog();
+
+	// Multi line text for the stats overlay
+	std::string summary() const;
+};
+
+#endif __GPU_PROFILER_H__
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "Headless.h"
+
+#if defined(OCEAN_OSMESA)
+#include <GL/osmesa.h>
+#elif defined(_WIN32)
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#endif
+
+#if defined(OCEAN_OSMESA)
+
+HeadlessContext::HeadlessContext() : context{ NULL }, buffer{ NULL } {}
+
+bool HeadlessContext::create() {
+	destroy();
+
+	const int attribs[] = {
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_DEPTH_BITS, 24,
+		OSMESA_PROFILE, OSMESA_COMPAT_PROFILE,
+		0
+	};
+	OSMesaContext ctx = OSMesaCreateContextAttribs(attribs, NULL);
+	if (ctx == NULL) {
+		printf("OSMesa context could not be created\n");
+		return false;
+	}
+
+	// OSMesa needs a color buffer to make the context current, the frames go to an FBO
+	buffer = new unsigned char[4];
+	if (!OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, 1, 1)) {
+		printf("OSMesa context could not be made current\n");
+		OSMesaDestroyContext(ctx);
+		delete[] buffer;
+		buffer = NULL;
+		return false;
+	}
+	context = ctx;
+	return true;
+}
+
+void HeadlessContext::destroy() {
+	if (context != NULL) {
+		OSMesaDestroyContext((OSMesaContext)context);
+		context = NULL;
+	}
+	delete[] buffer;
+	buffer = NULL;
+}
+
+#elif defined(_WIN32)
+
+HeadlessContext::HeadlessContext() : context{ NULL } {}
+
+bool HeadlessContext::create() {
+	destroy();
+
+	if (!glfwInit()) {
+		printf("GLFW could not be initialised\n");
+		return false;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow * window = glfwCreateWindow(64, 64, "headless", NULL, NULL);
+	glfwDefaultWindowHints();
+	if (window == NULL) {
+		printf("Hidden window could not be created\n");
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	context = window;
+	return true;
+}
+
+void HeadlessContext::destroy() {
+	if (context != NULL) {
+		glfwDestroyWindow((GLFWwindow *)context);
+		context = NULL;
+	}
+}
+
+#else
+
+HeadlessContext::HeadlessContext() : display{ EGL_NO_DISPLAY }, surface{ EGL_NO_SURFACE }, context{ NULL } {}
+
+namespace {
+	bool hasExtension(const char * list, const char * name) {
+		if (list == NULL) return false;
+		size_t n = strlen(name);
+		for (const char * p = strstr(list, name); p != NULL; p = strstr(p + n, name)) {
+			if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0')) return true;
+		}
+		return false;
+	}
+}
+
+bool HeadlessContext::create() {
+	destroy();
+
+	// EGL_MESA_platform_surfaceless needs neither X11, Wayland nor a DRM device
+	EGLDisplay dpy = EGL_NO_DISPLAY;
+	const char * clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != NULL) {
+			dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+	}
+	if (dpy == EGL_NO_DISPLAY) {
+		dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, NULL, NULL)) {
+		printf("EGL display could not be initialised\n");
+		return false;
+	}
+	display = dpy;
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		printf("EGL has no desktop OpenGL\n");
+		destroy();
+		return false;
+	}
+
+	bool surfaceless = hasExtension(eglQueryString(dpy, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(dpy, configAttribs, &config, 1, &count) || count == 0) {
+		printf("EGL config could not be found\n");
+		destroy();
+		return false;
+	}
+
+	// no version requested, like the windowed path: the driver's compatibility profile
+	EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+	if (ctx == EGL_NO_CONTEXT) {
+		printf("EGL context could not be created\n");
+		destroy();
+		return false;
+	}
+	context = ctx;
+
+	if (!surfaceless) {
+		const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(dpy, config, pbufferAttribs);
+		if (surface == EGL_NO_SURFACE) {
+			printf("EGL pbuffer could not be created\n");
+			destroy();
+			return false;
+		}
+	}
+
+	if (!eglMakeCurrent(dpy, surface, surface, ctx)) {
+		printf("EGL context could not be made current\n");
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::destroy() {
+	if (display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != NULL) eglDestroyContext(display, context);
+		if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+		eglTerminate(display);
+	}
+	display = EGL_NO_DISPLAY;
+	surface = EGL_NO_SURFACE;
+	context = NULL;
+}
+
+#endif
+
+HeadlessContext::~HeadlessContext() {
+	destroy();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+#include <cstddef>
+
+// OpenGL context without a window, for batch rendering on machines with no display.
+//
+// Linux uses EGL, surfaceless when Mesa offers it (llvmpipe works without a GPU)
+// and a 1x1 pbuffer otherwise. Define OCEAN_OSMESA to use OSMesa instead.
+// Windows falls back to a hidden GLFW window.
+//
+// Rendering still goes to a RenderTarget, the context has no usable default framebuffer.
+class HeadlessContext {
+private:
+#if defined(OCEAN_OSMESA)
+	void * context;
+	unsigned char * buffer;
+#elif defined(_WIN32)
+	void * context; // the hidden GLFWwindow
+#else
+	void * display;
+	void * surface;
+	void * context;
+#endif
+
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext &) = delete;
+	HeadlessContext & operator=(const HeadlessContext &) = delete;
+
+	// Creates the context and makes it current on the calling thread
+	bool create();
+	void destroy();
+
+	bool isCreated() const { return context != NULL; }
+};
+
+#endif __HEADLESS_H__
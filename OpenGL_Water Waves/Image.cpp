@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include "Image.h"
+#include "Trace.h"
+#include "stb_image.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+	// BMP fields are little endian and unaligned
+	inline uint32_t readU32(const unsigned char * p) {
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	inline uint16_t readU16(const unsigned char * p) {
+		return (uint16_t)(p[0] | (p[1] << 8));
+	}
+
+	bool hasExtension(const char * path, const char * extension) {
+		size_t n = strlen(path), e = strlen(extension);
+		if (n < e) return false;
+		for (size_t i = 0; i < e; i++) {
+			char c = path[n - e + i];
+			if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+			if (c != extension[i]) return false;
+		}
+		return true;
+	}
+}
+
+Image::Image() : decoded(NULL), pixels(NULL), stride(0), w(0), h(0), channels(0), bottomUp(true), pixelFormat(GL_RGB), pixelType(GL_UNSIGNED_BYTE) {
+}
+
+Image::~Image() {
+	release();
+}
+
+void Image::release() {
+	if (decoded != NULL) {
+		stbi_image_free(decoded);
+		decoded = NULL;
+	}
+	file.close();
+	pixels = NULL;
+	w = h = channels = 0;
+}
+
+bool Image::load(const char * path) {
+	TRACE_SCOPE("Image::load");
+	release();
+	return hasExtension(path, ".bmp") ? loadBMP(path) : loadDecoded(path);
+}
+
+bool Image::loadBMP(const char * path) {
+	if (!file.open(path)) {
+		printf("Image %s could not be opened\n", path);
+		return false;
+	}
+
+	// BITMAPFILEHEADER (14 bytes) then at least a BITMAPINFOHEADER (40 bytes)
+	const unsigned char * p = file.data();
+	if (file.size() < 54 || p[0] != 'B' || p[1] != 'M' || readU32(p + 14) < 40) {
+		printf("Image %s: not a correct BMP file\n", path);
+		release();
+		return false;
+	}
+
+	uint32_t dataPos = readU32(p + 10);
+	int32_t width = (int32_t)readU32(p + 18);
+	int32_t height = (int32_t)readU32(p + 22);
+	uint16_t bits = readU16(p + 28);
+	uint32_t compression = readU32(p + 30);
+
+	// BI_RGB, or BI_BITFIELDS with the usual BGRA masks for 32 bits
+	if ((bits != 24 && bits != 32) || (compression != 0 && !(compression == 3 && bits == 32)) || width <= 0 || height == 0) {
+		printf("Image %s: only uncompressed 24 and 32 bit BMP files are supported\n", path);
+		release();
+		return false;
+	}
+
+	// the masks follow the 40 byte header, the alpha one only in the larger headers.
+	// Any other layout is left to stb, which applies the masks.
+	if (compression == 3) {
+		uint32_t headerSize = readU32(p + 14);
+		bool standard = file.size() >= 70 &&
+			readU32(p + 54) == 0x00FF0000 && readU32(p + 58) == 0x0000FF00 && readU32(p + 62) == 0x000000FF &&
+			headerSize >= 56 && readU32(p + 66) == 0xFF000000;
+		if (!standard) {
+			release();
+			return loadDecoded(path);
+		}
+	}
+
+	// rows are padded to 4 bytes, stored bottom up unless the height is negative
+	size_t rowBytes = ((size_t)width * bits + 31) / 32 * 4;
+	size_t rows = height < 0 ? (size_t)-(int64_t)height : (size_t)height;
+	if (dataPos == 0) dataPos = 54;
+	if ((uint64_t)dataPos + rowBytes * rows > file.size()) {
+		printf("Image %s: pixel data is truncated\n", path);
+		release();
+		return false;
+	}
+
+	pixels = p + dataPos;
+	stride = (ptrdiff_t)rowBytes;
+	w = width;
+	h = (int)rows;
+	channels = bits / 8;
+	bottomUp = height > 0;
+	pixelFormat = channels == 4 ? GL_BGRA : GL_BGR;
+	pixelType = GL_UNSIGNED_BYTE;
+	return true;
+}
+
+bool Image::loadDecoded(const char * path) {
+	// decode from a mapping of the file, stdio is not needed
+	MappedFile source(path);
+	if (!source.isOpen()) {
+		printf("Image %s could not be opened\n", path);
+		return false;
+	}
+
+	int width, height, n;
+	bool hdr = stbi_is_hdr_from_memory(source.data(), (int)source.size()) != 0;
+	if (hdr) {
+		decoded = stbi_loadf_from_memory(source.data(), (int)source.size(), &width, &height, &n, 0);
+	}
+	else {
+		decoded = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &n, 0);
+	}
+	if (decoded == NULL) {
+		printf("Image %s could not be decoded: %s\n", path, stbi_failure_reason());
+		return false;
+	}
+
+	const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	w = width;
+	h = height;
+	channels = n;
+	pixelType = hdr ? GL_FLOAT : GL_UNSIGNED_BYTE;
+	pixelFormat = formats[n - 1];
+	pixels = (const unsigned char *)decoded;
+	stride = (ptrdiff_t)(w * pixelSize());
+	bottomUp = false; // stb decodes top row first
+	return true;
+}
+
+void Image::upload(GLuint texture, GLenum internalFormat) const {
+	TRACE_SCOPE("Image::upload");
+	size_t rowBytes = w * pixelSize();
+	size_t rowStride = (size_t)stride;
+
+	// describe the stride: an alignment covers the 4 byte padding of BMP rows,
+	// any other stride that is a whole number of pixels goes in ROW_LENGTH
+	GLint alignment = 0, rowLength = 0;
+	for (GLint a = 8; a >= 1; a /= 2) {
+		if ((rowBytes + a - 1) / a * a == rowStride) {
+			alignment = a;
+			break;
+		}
+	}
+	if (alignment == 0 && rowStride % pixelSize() == 0) {
+		alignment = 1;
+		rowLength = (GLint)(rowStride / pixelSize());
+	}
+	if (alignment == 0) { // neither, pack the rows tightly on the way into the buffer
+		alignment = 1;
+		rowStride = rowBytes;
+	}
+	size_t size = rowStride * (h - 1) + rowBytes;
+
+	GLuint pbo;
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	if (bottomUp && rowStride == (size_t)stride) {
+		// already in GL order, the driver copies straight out of the mapping
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, pixels, GL_STREAM_DRAW);
+	}
+	else {
+		// reverse the rows while filling the buffer
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		unsigned char * dst = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		for (int y = 0; y < h; y++) {
+			if (dst != NULL) memcpy(dst + y * rowStride, row(y), rowBytes);
+			else glBufferSubData(GL_PIXEL_UNPACK_BUFFER, y * rowStride, rowBytes, row(y));
+		}
+		if (dst != NULL) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	GLint savedAlignment, savedRowLength;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &savedAlignment);
+	glGetIntegerv(GL_UNPACK_ROW_LENGTH, &savedRowLength);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, pixelFormat, pixelType, (void*)0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, savedAlignment);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, savedRowLength);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &pbo);
+}
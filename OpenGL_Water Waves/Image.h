@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include <GL/glew.h>
+#include <cstddef>
+#include "MappedFile.h"
+
+// A decoded or mapped image, seen as rows of pixels with a stride.
+//
+// BMP files are mapped and their rows used where they lie, padding and order
+// included. Other formats (PNG, JPEG, HDR, ...) are decoded by stb_image, which
+// must be left with vertical flipping off: orientation is handled on upload.
+class Image {
+private:
+	MappedFile file;
+	void * decoded;              // stb_image allocation, NULL for mapped files
+
+	const unsigned char * pixels; // first row in memory
+	ptrdiff_t stride;             // bytes from one row to the next in memory
+	int w, h;
+	int channels;
+	bool bottomUp;                // first row in memory is the bottom one, as GL expects
+	GLenum pixelFormat;           // GL_RGB, GL_BGR, GL_RGBA, ...
+	GLenum pixelType;             // GL_UNSIGNED_BYTE or GL_FLOAT
+
+	bool loadBMP(const char * path);
+	bool loadDecoded(const char * path);
+
+public:
+	Image();
+	~Image();
+
+	Image(const Image &) = delete;
+	Image & operator=(const Image &) = delete;
+
+	// Chooses the loader from the extension
+	bool load(const char * path);
+	void release();
+
+	bool isLoaded() const { return pixels != NULL; }
+	int width() const { return w; }
+	int height() const { return h; }
+	int components() const { return channels; }
+	size_t pixelSize() const { return channels * (pixelType == GL_FLOAT ? sizeof(float) : 1); }
+	GLenum format() const { return pixelFormat; }
+	GLenum type() const { return pixelType; }
+
+	// Row y counted from the bottom, as texture coordinates are
+	const unsigned char * row(int y) const { return pixels + (bottomUp ? y : h - 1 - y) * stride; }
+
+	// Allocates the texture level 0 and uploads through a pixel unpack buffer.
+	// Rows keep their stride, described to GL with GL_UNPACK_ALIGNMENT or
+	// GL_UNPACK_ROW_LENGTH, so the only copy is the one into the buffer.
+	void upload(GLuint texture, GLenum internalFormat) const;
+};
+
+#endif __IMAGE_H__
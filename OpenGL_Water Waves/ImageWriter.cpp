@@ -0,0 +1,367 @@
+#include "stdafx.h"
+#include "ImageWriter.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_MATCH 258
+
+namespace {
+
+	const unsigned char * sourceRow(const void * pixels, int y, int width, int height, size_t pixelSize, bool bottomUp) {
+		return (const unsigned char *)pixels + (size_t)(bottomUp ? height - 1 - y : y) * width * pixelSize;
+	}
+
+	bool finish(FILE * file, bool ok, const char * path) {
+		if (fclose(file) != 0) ok = false;
+		if (!ok) printf("Image %s could not be written\n", path);
+		return ok;
+	}
+
+	// ------------------------------------------------------------------------
+	// PNG
+
+	struct CrcTable {
+		uint32_t entries[256];
+		CrcTable() {
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[n] = c;
+			}
+		}
+	};
+
+	uint32_t crc32(uint32_t crc, const unsigned char * data, size_t size) {
+		static const CrcTable table; // thread safe initialisation
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t adler32(const unsigned char * data, size_t size) {
+		uint32_t a = 1, b = 0;
+		while (size > 0) {
+			size_t n = size < 5552 ? size : 5552; // largest run before b can overflow
+			size -= n;
+			while (n--) {
+				a += *data++;
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void putBE32(std::vector<unsigned char> & out, uint32_t v) {
+		out.push_back((unsigned char)(v >> 24));
+		out.push_back((unsigned char)(v >> 16));
+		out.push_back((unsigned char)(v >> 8));
+		out.push_back((unsigned char)v);
+	}
+
+	class BitWriter {
+	private:
+		std::vector<unsigned char> & out;
+		uint32_t bits;
+		int count;
+	public:
+		BitWriter(std::vector<unsigned char> & o) : out(o), bits{ 0 }, count{ 0 } {}
+
+		// value is written least significant bit first, as deflate stores everything but Huffman codes
+		void put(uint32_t value, int n) {
+			bits |= value << count;
+			count += n;
+			while (count >= 8) {
+				out.push_back((unsigned char)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		// Huffman codes go most significant bit first
+		void putCode(uint32_t code, int n) {
+			uint32_t reversed = 0;
+			for (int i = 0; i < n; i++) reversed |= ((code >> i) & 1) << (n - 1 - i);
+			put(reversed, n);
+		}
+
+		void flush() {
+			if (count > 0) out.push_back((unsigned char)bits);
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Fixed literal/length code of RFC 1951 3.2.6
+	void putSymbol(BitWriter & bw, int symbol) {
+		if (symbol < 144)      bw.putCode(0x30 + symbol, 8);
+		else if (symbol < 256) bw.putCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280) bw.putCode(symbol - 256, 7);
+		else                   bw.putCode(0xC0 + symbol - 280, 8);
+	}
+
+	void putMatch(BitWriter & bw, int length, int distance) {
+		int l = 28;
+		while (lengthBase[l] > length) l--;
+		putSymbol(bw, 257 + l);
+		bw.put(length - lengthBase[l], lengthExtra[l]);
+
+		int d = 29;
+		while (distanceBase[d] > distance) d--;
+		bw.putCode(d, 5);
+		bw.put(distance - distanceBase[d], distanceExtra[d]);
+	}
+
+	// zlib stream with a single fixed Huffman block. One candidate per hash
+	// bucket keeps it fast, filtered image rows still compress well.
+	void deflateFixed(const unsigned char * data, size_t size, std::vector<unsigned char> & out) {
+		out.push_back(0x78);
+		out.push_back(0x01);
+
+		BitWriter bw(out);
+		bw.put(1, 1); // final block
+		bw.put(1, 2); // fixed Huffman
+
+		std::vector<int64_t> head((size_t)1 << DEFLATE_HASH_BITS, -1);
+		size_t i = 0;
+		while (i < size) {
+			int length = 0;
+			size_t candidate = 0;
+			if (i + 3 <= size) {
+				uint32_t h = ((data[i] << 16) | (data[i + 1] << 8) | data[i + 2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+				int64_t c = head[h];
+				head[h] = (int64_t)i;
+				if (c >= 0 && i - (size_t)c <= DEFLATE_WINDOW) {
+					candidate = (size_t)c;
+					size_t limit = size - i < DEFLATE_MAX_MATCH ? size - i : DEFLATE_MAX_MATCH;
+					while ((size_t)length < limit && data[candidate + length] == data[i + length]) length++;
+				}
+			}
+
+			if (length >= 3) {
+				putMatch(bw, length, (int)(i - candidate));
+				i += length;
+			}
+			else {
+				putSymbol(bw, data[i]);
+				i++;
+			}
+		}
+		putSymbol(bw, 256);
+		bw.flush();
+
+		putBE32(out, adler32(data, size));
+	}
+
+	void putChunk(FILE * file, const char * type, const unsigned char * data, size_t size, bool & ok) {
+		unsigned char word[4] = { (unsigned char)(size >> 24), (unsigned char)(size >> 16), (unsigned char)(size >> 8), (unsigned char)size };
+		uint32_t crc = crc32(crc32(0, (const unsigned char *)type, 4), data, size);
+		unsigned char crcBytes[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+		ok = ok && fwrite(word, 1, 4, file) == 4;
+		ok = ok && fwrite(type, 1, 4, file) == 4;
+		ok = ok && (size == 0 || fwrite(data, 1, size, file) == size);
+		ok = ok && fwrite(crcBytes, 1, 4, file) == 4;
+	}
+
+	// ------------------------------------------------------------------------
+	// EXR
+
+	void putLE32(std::vector<unsigned char> & out, uint32_t v) {
+		for (int i = 0; i < 4; i++) out.push_back((unsigned char)(v >> (8 * i)));
+	}
+
+	void putFloat(std::vector<unsigned char> & out, float f) {
+		uint32_t v;
+		memcpy(&v, &f, 4);
+		putLE32(out, v);
+	}
+
+	void putAttribute(std::vector<unsigned char> & out, const char * name, const char * type, uint32_t size) {
+		out.insert(out.end(), name, name + strlen(name) + 1);
+		out.insert(out.end(), type, type + strlen(type) + 1);
+		putLE32(out, size);
+	}
+}
+
+ImageFormat imageFormatFromPath(const char * path) {
+	const char * dot = strrchr(path, '.');
+	if (dot != NULL) {
+		if (strcmp(dot, ".raw") == 0) return ImageRaw;
+		if (strcmp(dot, ".png") == 0) return ImagePNG;
+		if (strcmp(dot, ".exr") == 0) return ImageEXR;
+	}
+	return ImagePPM;
+}
+
+bool writeImage(const char * path, ImageFormat format, int width, int height, const void * pixels, bool bottomUp) {
+	switch (format) {
+	case ImageRaw: return writeRaw(path, width, height, imagePixelSize(format), pixels, bottomUp);
+	case ImagePNG: return writePNG(path, width, height, (const unsigned char *)pixels, bottomUp);
+	case ImageEXR: return writeEXR(path, width, height, (const unsigned short *)pixels, bottomUp);
+	default:       return writePPM(path, width, height, (const unsigned char *)pixels, bottomUp);
+	}
+}
+
+bool writePPM(const char * path, int width, int height, const unsigned char * rgba, bool bottomUp) {
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Image %s could not be opened\n", path);
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	std::vector<unsigned char> row(width * 3);
+	bool ok = true;
+	for (int y = 0; y < height && ok; y++) {
+		const unsigned char * src = sourceRow(rgba, y, width, height, 4, bottomUp);
+		for (int x = 0; x < width; x++) {
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	return finish(file, ok, path);
+}
+
+bool writePNG(const char * path, int width, int height, const unsigned char * rgba, bool bottomUp) {
+	// Sub filter on RGB: each byte minus the same channel of the pixel to its left
+	size_t stride = (size_t)width * 3 + 1;
+	std::vector<unsigned char> filtered(stride * height);
+	for (int y = 0; y < height; y++) {
+		const unsigned char * src = sourceRow(rgba, y, width, height, 4, bottomUp);
+		unsigned char * dst = &filtered[y * stride];
+		dst[0] = 1;
+		for (int x = 0; x < width; x++) {
+			for (int c = 0; c < 3; c++) {
+				unsigned char left = x > 0 ? src[(x - 1) * 4 + c] : 0;
+				dst[1 + x * 3 + c] = (unsigned char)(src[x * 4 + c] - left);
+			}
+		}
+	}
+
+	std::vector<unsigned char> idat;
+	idat.reserve(filtered.size() / 2);
+	deflateFixed(filtered.data(), filtered.size(), idat);
+
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Image %s could not be opened\n", path);
+		return false;
+	}
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<unsigned char> ihdr;
+	putBE32(ihdr, width);
+	putBE32(ihdr, height);
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(2); // RGB
+	ihdr.push_back(0); // deflate
+	ihdr.push_back(0); // adaptive filtering
+	ihdr.push_back(0); // not interlaced
+
+	bool ok = fwrite(signature, 1, 8, file) == 8;
+	putChunk(file, "IHDR", ihdr.data(), ihdr.size(), ok);
+	putChunk(file, "IDAT", idat.data(), idat.size(), ok);
+	putChunk(file, "IEND", NULL, 0, ok);
+
+	return finish(file, ok, path);
+}
+
+bool writeEXR(const char * path, int width, int height, const unsigned short * rgbaHalf, bool bottomUp) {
+	std::vector<unsigned char> header;
+	putLE32(header, 20000630); // magic
+	putLE32(header, 2);        // version 2, single part scanline
+
+	// channels are stored in alphabetical order
+	const char * channels[3] = { "B", "G", "R" };
+	const int offsets[3] = { 2, 1, 0 };
+	putAttribute(header, "channels", "chlist", 3 * 18 + 1);
+	for (int c = 0; c < 3; c++) {
+		header.push_back(channels[c][0]);
+		header.push_back(0);
+		putLE32(header, 1); // HALF
+		putLE32(header, 0); // pLinear and reserved
+		putLE32(header, 1); // x sampling
+		putLE32(header, 1); // y sampling
+	}
+	header.push_back(0);
+
+	putAttribute(header, "compression", "compression", 1);
+	header.push_back(0); // NO_COMPRESSION
+	putAttribute(header, "dataWindow", "box2i", 16);
+	putLE32(header, 0); putLE32(header, 0); putLE32(header, width - 1); putLE32(header, height - 1);
+	putAttribute(header, "displayWindow", "box2i", 16);
+	putLE32(header, 0); putLE32(header, 0); putLE32(header, width - 1); putLE32(header, height - 1);
+	putAttribute(header, "lineOrder", "lineOrder", 1);
+	header.push_back(0); // INCREASING_Y
+	putAttribute(header, "pixelAspectRatio", "float", 4);
+	putFloat(header, 1.0f);
+	putAttribute(header, "screenWindowCenter", "v2f", 8);
+	putFloat(header, 0.0f); putFloat(header, 0.0f);
+	putAttribute(header, "screenWindowWidth", "float", 4);
+	putFloat(header, 1.0f);
+	header.push_back(0);
+
+	// one scanline per block: y, byte count, then each channel's row
+	uint32_t blockSize = 8 + (uint32_t)width * 3 * 2;
+	uint64_t offset = header.size() + (uint64_t)height * 8;
+	for (int y = 0; y < height; y++) {
+		uint64_t o = offset + (uint64_t)y * blockSize;
+		putLE32(header, (uint32_t)o);
+		putLE32(header, (uint32_t)(o >> 32));
+	}
+
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Image %s could not be opened\n", path);
+		return false;
+	}
+
+	bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+	std::vector<unsigned char> block(blockSize);
+	for (int y = 0; y < height && ok; y++) {
+		const unsigned short * src = (const unsigned short *)sourceRow(rgbaHalf, y, width, height, 8, bottomUp);
+		unsigned char * dst = &block[0];
+		for (int i = 0; i < 4; i++) *dst++ = (unsigned char)(y >> (8 * i));
+		for (int i = 0; i < 4; i++) *dst++ = (unsigned char)((blockSize - 8) >> (8 * i));
+		for (int c = 0; c < 3; c++) {
+			for (int x = 0; x < width; x++) {
+				unsigned short h = src[x * 4 + offsets[c]];
+				*dst++ = (unsigned char)h;
+				*dst++ = (unsigned char)(h >> 8);
+			}
+		}
+		ok = fwrite(block.data(), 1, block.size(), file) == block.size();
+	}
+
+	return finish(file, ok, path);
+}
+
+bool writeRaw(const char * path, int width, int height, size_t pixelSize, const void * pixels, bool bottomUp) {
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Image %s could not be opened\n", path);
+		return false;
+	}
+
+	bool ok = true;
+	size_t rowSize = (size_t)width * pixelSize;
+	for (int y = 0; y < height && ok; y++) {
+		ok = fwrite(sourceRow(pixels, y, width, height, pixelSize, bottomUp), 1, rowSize, file) == rowSize;
+	}
+
+	return finish(file, ok, path);
+}
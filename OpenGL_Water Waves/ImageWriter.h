@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef __IMAGE_WRITER_H__
+#define __IMAGE_WRITER_H__
+
+#include <cstddef>
+
+// Frame encoders for captured images. The input is always what glReadPixels
+// returns for GL_RGBA: 8-bit channels, or half floats for ImageEXR.
+//
+//   ImageRaw  the pixels as read, rows top to bottom, no header
+//   ImagePPM  binary PPM, RGB
+//   ImagePNG  RGB, Sub filtered, LZ77 with the fixed deflate code
+//   ImageEXR  uncompressed scanline OpenEXR, half RGB
+enum ImageFormat { ImageRaw, ImagePPM, ImagePNG, ImageEXR };
+
+// Picks the format from the extension of path (.raw, .ppm, .png, .exr), PPM if unknown.
+ImageFormat imageFormatFromPath(const char * path);
+
+// Bytes per pixel of the glReadPixels data the format expects
+inline size_t imagePixelSize(ImageFormat format) { return format == ImageEXR ? 8 : 4; }
+
+// bottomUp is true for rows straight from glReadPixels.
+bool writeImage(const char * path, ImageFormat format, int width, int height, const void * pixels, bool bottomUp);
+
+bool writePPM(const char * path, int width, int height, const unsigned char * rgba, bool bottomUp);
+bool writePNG(const char * path, int width, int height, const unsigned char * rgba, bool bottomUp);
+bool writeEXR(const char * path, int width, int height, const unsigned short * rgbaHalf, bool bottomUp);
+bool writeRaw(const char * path, int width, int height, size_t pixelSize, const void * pixels, bool bottomUp);
+
+#endif __IMAGE_WRITER_H__
@@ -10,6 +10,7 @@
 
 #include <GL/glew.h>
 #include "LoadShaders.h"
+#include "MappedFile.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,35 +18,19 @@ extern "C" {
 
 //----------------------------------------------------------------------------
 
-static const GLchar*
-ReadShader( const char* filename )
+// Maps the source, from the asset pack when one is mounted. GL copies it
+// in glShaderSource, so the mapping is the only read.
+static bool
+ReadShader( const char* filename, MappedFile& source )
 {
-#ifdef WIN32
-	FILE* infile;
-	fopen_s( &infile, filename, "rb" );
-#else
-    FILE* infile = fopen( filename, "rb" );
-#endif // WIN32
-
-    if ( !infile ) {
+    if ( !source.open( filename ) ) {
 #ifdef _DEBUG
         std::cerr << "Unable to open file '" << filename << "'" << std::endl;
 #endif /* DEBUG */
-        return NULL;
+        return false;
     }
 
-    fseek( infile, 0, SEEK_END );
-    int len = ftell( infile );
-    fseek( infile, 0, SEEK_SET );
-
-    GLchar* source = new GLchar[len+1];
-
-    fread( source, 1, len, infile );
-    fclose( infile );
-
-    source[len] = 0;
-
-    return const_cast<const GLchar*>(source);
+    return true;
 }
 
 //----------------------------------------------------------------------------
@@ -63,8 +48,8 @@ LoadShaders(ShaderInfo* shaders)
 
         entry->shader = shader;
 
-        const GLchar* source = ReadShader( entry->filename );
-        if ( source == NULL ) {
+        MappedFile source;
+        if ( !ReadShader( entry->filename, source ) ) {
             for ( entry = shaders; entry->type != GL_NONE; ++entry ) {
                 glDeleteShader( entry->shader );
                 entry->shader = 0;
@@ -73,8 +58,9 @@ LoadShaders(ShaderInfo* shaders)
             return 0;
         }
 
-        glShaderSource( shader, 1, &source, NULL );
-        delete [] source;
+        const GLchar* text = (const GLchar*)source.data();
+        GLint length = (GLint)source.size();
+        glShaderSource( shader, 1, &text, &length );
 
         glCompileShader( shader );
 
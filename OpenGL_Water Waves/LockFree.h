@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef __LOCK_FREE_H__
+#define __LOCK_FREE_H__
+
+#include <atomic>
+
+// Latest value handoff between one writer and one reader thread. The writer
+// fills writeBuffer() and publishes it, the reader picks the newest published
+// value up with update(). Neither side ever waits: values published between
+// two updates are skipped, and the reader keeps the one it has until a newer
+// one arrives.
+template <class T>
+class TripleBuffer {
+private:
+	static const int INDEX = 3;
+	static const int FRESH = 4; // the middle slot holds a value the reader has not seen
+
+	T slots[3];
+	int back;                // writer's slot
+	std::atomic<int> middle; // slot in flight, with FRESH
+	int front;               // reader's slot
+
+public:
+	TripleBuffer() : back{ 0 }, middle{ 1 }, front{ 2 } {}
+
+	TripleBuffer(const TripleBuffer &) = delete;
+	TripleBuffer & operator=(const TripleBuffer &) = delete;
+
+	// Before either thread starts
+	void reset(const T & value) {
+		slots[0] = slots[1] = slots[2] = value;
+	}
+
+	// Writer side
+	T & writeBuffer() { return slots[back]; }
+	void publish() {
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Reader side, true when readBuffer() changed
+	bool update() {
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+	const T & readBuffer() const { return slots[front]; }
+};
+
+// Bounded queue between one producer and one consumer thread. N is a power
+// of two, push() fails rather than waits when the queue is full.
+template <class T, unsigned int N>
+class SpscQueue {
+private:
+	static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+	T items[N];
+	std::atomic<unsigned int> head; // next to pop, written by the consumer
+	std::atomic<unsigned int> tail; // next to push, written by the producer
+
+public:
+	SpscQueue() : head{ 0 }, tail{ 0 } {}
+
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue & operator=(const SpscQueue &) = delete;
+
+	bool push(const T & item) {
+		unsigned int t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N) return false;
+		items[t & (N - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T & item) {
+		unsigned int h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		item = items[h & (N - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+#endif __LOCK_FREE_H__
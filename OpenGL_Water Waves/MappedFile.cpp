@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+#include "AssetPack.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : ptr{ NULL }, length{ 0 }, view{ false }, file{ INVALID_HANDLE_VALUE }, mapping{ NULL } {}
+#else
+MappedFile::MappedFile() : ptr{ NULL }, length{ 0 }, view{ false }, fd{ -1 } {}
+#endif
+
+MappedFile::MappedFile(const char * path) : MappedFile() {
+	open(path);
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile && other) : MappedFile() {
+	*this = std::move(other);
+}
+
+MappedFile & MappedFile::operator=(MappedFile && other) {
+	if (this != &other) {
+		close();
+		ptr = other.ptr;
+		length = other.length;
+		view = other.view;
+		other.ptr = NULL;
+		other.length = 0;
+		other.view = false;
+#ifdef _WIN32
+		file = other.file;
+		mapping = other.mapping;
+		other.file = INVALID_HANDLE_VALUE;
+		other.mapping = NULL;
+#else
+		fd = other.fd;
+		other.fd = -1;
+#endif
+	}
+	return *this;
+}
+
+bool MappedFile::open(const char * path) {
+	close();
+
+	size_t size;
+	const unsigned char * asset = findAsset(path, &size);
+	if (asset != NULL && size > 0) {
+		ptr = asset;
+		length = size;
+		view = true;
+		return true;
+	}
+
+	return openFile(path);
+}
+
+bool MappedFile::openFile(const char * path) {
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+
+	ptr = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (ptr == NULL) {
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+#else
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close();
+		return false;
+	}
+
+	void * p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		close();
+		return false;
+	}
+	ptr = (const unsigned char *)p;
+	length = (size_t)st.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (view) {
+		ptr = NULL;
+		length = 0;
+		view = false;
+		return;
+	}
+
+#ifdef _WIN32
+	if (ptr != NULL) UnmapViewOfFile(ptr);
+	if (mapping != NULL) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (ptr != NULL) munmap((void *)ptr, length);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+	ptr = NULL;
+	length = 0;
+}
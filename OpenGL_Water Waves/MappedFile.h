@@ -0,0 +1,44 @@
+#pragma once
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+// Uses CreateFileMapping on Windows and mmap everywhere else.
+class MappedFile {
+private:
+	const unsigned char * ptr;
+	size_t length;
+	bool view; // points into the mounted asset pack, which owns the mapping
+
+#ifdef _WIN32
+	void * file;
+	void * mapping;
+#else
+	int fd;
+#endif
+
+public:
+	MappedFile();
+	MappedFile(const char * path);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+	MappedFile(MappedFile && other);
+	MappedFile & operator=(MappedFile && other);
+
+	// Looks path up in the mounted asset pack (see AssetPack.h) before the disk
+	bool open(const char * path);
+	// Maps the file on disk, ignoring the asset pack
+	bool openFile(const char * path);
+	void close();
+
+	bool isOpen() const { return ptr != NULL; }
+	const unsigned char * data() const { return ptr; }
+	size_t size() const { return length; }
+};
+
+#endif __MAPPED_FILE_H__
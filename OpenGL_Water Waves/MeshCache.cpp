@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "Tables.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Sections start on 64 byte boundaries
+#define MESH_SECTION_ALIGN 64
+
+namespace {
+	inline uint32_t alignUp(uint32_t offset) {
+		return (offset + MESH_SECTION_ALIGN - 1) & ~(uint32_t)(MESH_SECTION_ALIGN - 1);
+	}
+
+	inline int16_t snorm16(float v) {
+		return (int16_t)lroundf(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+	}
+
+	inline float signNotZero(float v) {
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	bool writeSection(FILE * file, const void * data, uint32_t size, long & at) {
+		static const unsigned char padding[MESH_SECTION_ALIGN] = { 0 };
+		uint32_t pad = alignUp((uint32_t)at) - (uint32_t)at;
+		bool ok = (pad == 0 || fwrite(padding, pad, 1, file) == 1) && (size == 0 || fwrite(data, size, 1, file) == 1);
+		at += pad + size;
+		return ok;
+	}
+}
+
+void encodeOctahedral(const float * normal, int16_t * encoded) {
+	float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	if (l1 == 0.0f) { // no normal, decodes to +z
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+	float x = normal[0] / l1, y = normal[1] / l1;
+	if (normal[2] < 0.0f) { // fold the lower hemisphere over the diagonals
+		float fx = (1.0f - fabsf(y)) * signNotZero(x);
+		float fy = (1.0f - fabsf(x)) * signNotZero(y);
+		x = fx;
+		y = fy;
+	}
+	encoded[0] = snorm16(x);
+	encoded[1] = snorm16(y);
+}
+
+void decodeOctahedral(const int16_t * encoded, float * normal) {
+	float x = std::max(encoded[0] / 32767.0f, -1.0f), y = std::max(encoded[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+bool writeMeshCache(const char * path, const ObjMesh & mesh) {
+	std::vector<PackedVertex20> vertices(mesh.vertices.size());
+	MeshHeader header;
+	memset(&header, 0, sizeof(header));
+	for (int k = 0; k < 3; k++) {
+		header.boundsMin[k] = FLT_MAX;
+		header.boundsMax[k] = -FLT_MAX;
+	}
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const ObjVertex & v = mesh.vertices[i];
+		PackedVertex20 & p = vertices[i];
+		p.position[0] = v.position.x;
+		p.position[1] = v.position.y;
+		p.position[2] = v.position.z;
+		p.uv[0] = floatToHalf(v.uv.x);
+		p.uv[1] = floatToHalf(v.uv.y);
+		float normal[3] = { v.normal.x, v.normal.y, v.normal.z };
+		encodeOctahedral(normal, p.normal);
+		for (int k = 0; k < 3; k++) {
+			header.boundsMin[k] = std::min(header.boundsMin[k], p.position[k]);
+			header.boundsMax[k] = std::max(header.boundsMax[k], p.position[k]);
+		}
+	}
+
+	bool shortIndices = vertices.size() <= 65536;
+	std::vector<uint16_t> shorts;
+	if (shortIndices) shorts.assign(mesh.indices.begin(), mesh.indices.end());
+
+	memcpy(header.magic, MESH_MAGIC, 4);
+	header.version = MESH_VERSION;
+	header.vertexFormat = MESH_VERTEX_PACKED;
+	header.flags = (mesh.hasUvs ? MESH_HAS_UVS : 0) | (mesh.hasNormals ? MESH_HAS_NORMALS : 0);
+	header.vertexCount = (uint32_t)vertices.size();
+	header.indexCount = (uint32_t)mesh.indices.size();
+	header.indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	header.vertexOffset = alignUp(sizeof(MeshHeader));
+	header.vertexSize = (uint32_t)(vertices.size() * sizeof(PackedVertex20));
+	header.indexOffset = alignUp(header.vertexOffset + header.vertexSize);
+	header.indexSize = (uint32_t)(mesh.indices.size() * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)));
+
+	const void * indexData = shortIndices ? (const void *)shorts.data() : (const void *)mesh.indices.data();
+	// the checksum runs over both sections as laid out, padding excluded
+	uint32_t vertexHash = tableChecksum(vertices.data(), header.vertexSize);
+	header.checksum = vertexHash ^ tableChecksum(indexData, header.indexSize);
+
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Mesh cache %s could not be written\n", path);
+		return false;
+	}
+
+	long at = 0;
+	bool ok = writeSection(file, &header, sizeof(header), at) &&
+		writeSection(file, vertices.data(), header.vertexSize, at) &&
+		writeSection(file, indexData, header.indexSize, at);
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok) {
+		printf("Mesh cache %s could not be written\n", path);
+		remove(path);
+	}
+	return ok;
+}
+
+bool buildMeshCache(const char * objPath, const char * cachePath) {
+	ObjMesh mesh;
+	if (!loadObjMesh(objPath, mesh)) {
+		return false;
+	}
+	optimizeMesh(mesh);
+	return writeMeshCache(cachePath, mesh);
+}
+
+MeshCache::MeshCache() {
+	memset(&header, 0, sizeof(header));
+}
+
+bool MeshCache::open(const char * path, bool verify) {
+	TRACE_SCOPE("MeshCache::open");
+	close();
+
+	if (!file.open(path)) {
+		printf("Mesh cache %s could not be opened\n", path);
+		return false;
+	}
+	if (file.size() < sizeof(MeshHeader)) {
+		printf("Mesh cache %s is too small to contain a header\n", path);
+		close();
+		return false;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, MESH_MAGIC, 4) != 0 || header.version != MESH_VERSION || header.vertexFormat != MESH_VERTEX_PACKED) {
+		printf("Mesh cache %s: not a mesh file or unsupported version\n", path);
+		close();
+		return false;
+	}
+	if (header.indexType != GL_UNSIGNED_SHORT && header.indexType != GL_UNSIGNED_INT) {
+		printf("Mesh cache %s: unsupported index type 0x%x\n", path, header.indexType);
+		close();
+		return false;
+	}
+
+	size_t indexBytes = header.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+	if (header.vertexSize != (uint64_t)header.vertexCount * sizeof(PackedVertex20) ||
+		header.indexSize != (uint64_t)header.indexCount * indexBytes ||
+		(uint64_t)header.vertexOffset + header.vertexSize > file.size() ||
+		(uint64_t)header.indexOffset + header.indexSize > file.size()) {
+		printf("Mesh cache %s is truncated\n", path);
+		close();
+		return false;
+	}
+
+	if (verify && (tableChecksum(vertices(), header.vertexSize) ^ tableChecksum(indices(), header.indexSize)) != header.checksum) {
+		printf("Mesh cache %s checksum mismatch\n", path);
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MeshCache::close() {
+	file.close();
+	memset(&header, 0, sizeof(header));
+}
+
+void MeshCache::upload(GLuint vao, GLuint vbo, GLuint ibo, bool immutable) const {
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	if (immutable && GLEW_ARB_buffer_storage) {
+		glBufferStorage(GL_ARRAY_BUFFER, header.vertexSize, vertices(), 0);
+		glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, header.indexSize, indices(), 0);
+	}
+	else {
+		glBufferData(GL_ARRAY_BUFFER, header.vertexSize, vertices(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, header.indexSize, indices(), GL_STATIC_DRAW);
+	}
+
+	GLsizei stride = sizeof(PackedVertex20);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex20, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex20, uv));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex20, normal));
+
+	glBindVertexArray(0);
+}
+
+void MeshCache::draw() const {
+	glDrawElements(GL_TRIANGLES, header.indexCount, header.indexType, NULL);
+}
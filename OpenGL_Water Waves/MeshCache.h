@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef __MESH_CACHE_H__
+#define __MESH_CACHE_H__
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstddef>
+#include "MappedFile.h"
+
+struct ObjMesh;
+
+// Binary mesh files, built once from OBJ and mapped on load:
+//   MeshHeader | vertices | indices
+// Both sections start on a 64 byte boundary and are uploaded straight from the
+// mapping, with no intermediate copy.
+
+#define MESH_MAGIC "OMSH"
+#define MESH_VERSION 1
+
+enum MeshVertexFormat { MESH_VERTEX_PACKED = 1 };
+enum MeshFlags { MESH_HAS_UVS = 1, MESH_HAS_NORMALS = 2 };
+
+// 20 bytes per vertex. The normal is octahedral encoded, packed_mesh.vs.glsl
+// decodes it.
+struct PackedVertex20 {
+	float    position[3];
+	uint16_t uv[2];       // half floats
+	int16_t  normal[2];   // snorm16 octahedral
+};
+
+struct MeshHeader {
+	char     magic[4];
+	uint16_t version;
+	uint16_t vertexFormat;  // MeshVertexFormat
+	uint32_t flags;         // MeshFlags
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t vertexOffset;  // from the start of the file
+	uint32_t vertexSize;    // in bytes
+	uint32_t indexOffset;
+	uint32_t indexSize;
+	float    boundsMin[3];
+	float    boundsMax[3];
+	uint32_t checksum;      // FNV-1a of the vertices xor FNV-1a of the indices
+	uint32_t reserved;
+};
+
+void encodeOctahedral(const float * normal, int16_t * encoded);
+void decodeOctahedral(const int16_t * encoded, float * normal);
+
+// Quantises a mesh, 16 bit indices when the vertex count allows, and writes it
+bool writeMeshCache(const char * path, const ObjMesh & mesh);
+
+// Loads an OBJ, optimises it for the vertex cache and writes the binary file
+bool buildMeshCache(const char * objPath, const char * cachePath);
+
+// A mapped mesh file
+class MeshCache {
+private:
+	MappedFile file;
+	MeshHeader header;
+
+public:
+	MeshCache();
+
+	// Maps and validates the file. The checksum reads every byte, which can be
+	// skipped for files produced on this machine.
+	bool open(const char * path, bool verify = true);
+	void close();
+
+	const MeshHeader & info() const { return header; }
+	const void * vertices() const { return file.data() + header.vertexOffset; }
+	const void * indices() const { return file.data() + header.indexOffset; }
+
+	// Fills the bound vertex array: buffers from the mapping, attributes 0 position,
+	// 1 uv, 2 octahedral normal. With immutable set the buffers are made with
+	// glBufferStorage, initialised from the mapping and never reallocated.
+	void upload(GLuint vao, GLuint vbo, GLuint ibo, bool immutable = false) const;
+
+	void draw() const;
+};
+
+#endif __MESH_CACHE_H__
@@ -0,0 +1,362 @@
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Caches of the ordering and of the analysis. Ordering for a larger LRU cache
+// also does well on the smaller FIFO caches of real hardware.
+#define OPTIMIZER_CACHE_SIZE 32
+#define ANALYZER_CACHE_SIZE 16
+
+// Resolution of the overdraw views
+#define OVERDRAW_GRID 256
+
+#define REMAP_NONE 0xffffffffu
+
+namespace {
+
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	float vertexScore(int cachePosition, unsigned int remaining) {
+		if (remaining == 0) return -1.0f; // nothing left to draw with it
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				// fixed score for the last triangle, so its vertices are not favoured over others in the cache
+				score = lastTriangleScore;
+			}
+			else {
+				float scale = 1.0f / (OPTIMIZER_CACHE_SIZE - 3);
+				score = powf(1.0f - (cachePosition - 3) * scale, cacheDecayPower);
+			}
+		}
+		// prefer vertices with few triangles left, so lonely triangles are not stranded
+		return score + valenceBoostScale * powf((float)remaining, -valenceBoostPower);
+	}
+
+	inline const float * position(const float * positions, size_t stride, GLuint v) {
+		return (const float *)((const char *)positions + v * stride);
+	}
+
+	// FIFO cache simulation: a vertex is cached while fewer than size misses
+	// happened since it was loaded
+	struct FifoCache {
+		std::vector<unsigned int> loadedAt;
+		unsigned int misses;
+		unsigned int size;
+
+		FifoCache(size_t vertexCount, unsigned int size) : loadedAt(vertexCount, 0), misses(size + 1), size(size) {}
+
+		void reset() { misses += size + 1; }
+
+		int triangle(const GLuint * t) {
+			int m = 0;
+			for (int k = 0; k < 3; k++) {
+				if (misses - loadedAt[t[k]] > size) {
+					loadedAt[t[k]] = misses++;
+					m++;
+				}
+			}
+			return m;
+		}
+	};
+
+	float rasterizeOverdraw(const std::vector<GLuint> & indices, const float * positions, size_t stride,
+		const float * lo, const float * hi, int axis, float sign) {
+		int ua = (axis + 1) % 3, va = (axis + 2) % 3;
+		float su = (OVERDRAW_GRID - 1) / std::max(hi[ua] - lo[ua], 1e-6f);
+		float sv = (OVERDRAW_GRID - 1) / std::max(hi[va] - lo[va], 1e-6f);
+
+		std::vector<float> depth(OVERDRAW_GRID * OVERDRAW_GRID, FLT_MAX);
+		size_t shaded = 0;
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			float x[3], y[3], z[3];
+			for (int k = 0; k < 3; k++) {
+				const float * p = position(positions, stride, indices[i + k]);
+				x[k] = (p[ua] - lo[ua]) * su;
+				y[k] = (p[va] - lo[va]) * sv;
+				z[k] = p[axis] * sign;
+			}
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			// the viewer looks down the axis by sign, counter clockwise faces towards it
+			// have a normal against sign, which is the sign of the projected area
+			if (area * sign > -1e-12f) continue;
+
+			int x0 = std::max(0, (int)ceilf(std::min(x[0], std::min(x[1], x[2])) - 0.5f));
+			int x1 = std::min(OVERDRAW_GRID - 1, (int)floorf(std::max(x[0], std::max(x[1], x[2])) - 0.5f));
+			int y0 = std::max(0, (int)ceilf(std::min(y[0], std::min(y[1], y[2])) - 0.5f));
+			int y1 = std::min(OVERDRAW_GRID - 1, (int)floorf(std::max(y[0], std::max(y[1], y[2])) - 0.5f));
+
+			for (int py = y0; py <= y1; py++) {
+				for (int px = x0; px <= x1; px++) {
+					float cx = px + 0.5f, cy = py + 0.5f;
+					float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) / area;
+					float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) / area;
+					float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+					float d = w0 * z[0] + w1 * z[1] + w2 * z[2];
+					float & stored = depth[py * OVERDRAW_GRID + px];
+					if (d < stored) {
+						stored = d;
+						shaded++;
+					}
+				}
+			}
+		}
+
+		size_t covered = 0;
+		for (float d : depth) covered += d != FLT_MAX;
+		return covered > 0 ? (float)shaded / covered : 0.0f;
+	}
+}
+
+void optimizeVertexCache(std::vector<GLuint> & indices, size_t vertexCount) {
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	// triangles of every vertex, the first remaining[v] ones are not drawn yet
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (GLuint v : indices) remaining[v]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(indices.size());
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) score[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+	}
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	std::vector<GLuint> cache, nextCache;
+	cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+	nextCache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+
+	size_t cursor = 0;
+	long long best = (long long)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	for (size_t drawn = 0; drawn < triangleCount; drawn++) {
+		if (best < 0) {
+			// nothing in the cache connects to a triangle left, restart at the next one in input order
+			while (emitted[cursor]) cursor++;
+			best = (long long)cursor;
+		}
+
+		const GLuint * t = &indices[3 * best];
+		emitted[best] = 1;
+		result.insert(result.end(), t, t + 3);
+
+		nextCache.clear();
+		for (int k = 0; k < 3; k++) {
+			GLuint v = t[k];
+			// take the triangle off the vertex's list of remaining ones
+			unsigned int * list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++) {
+				if (list[j] == (unsigned int)best) {
+					list[j] = list[--remaining[v]];
+					break;
+				}
+			}
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) nextCache.push_back(v);
+		}
+		for (GLuint v : cache) {
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) nextCache.push_back(v);
+		}
+
+		// new cache positions, vertices past the end drop out, then rescore
+		// every vertex that moved and the triangles left around it
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			GLuint v = nextCache[i];
+			cachePosition[v] = i < OPTIMIZER_CACHE_SIZE ? (int)i : -1;
+			float newScore = vertexScore(cachePosition[v], remaining[v]);
+			float delta = newScore - score[v];
+			score[v] = newScore;
+			const unsigned int * list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++) triangleScore[list[j]] += delta;
+		}
+		nextCache.resize(std::min(nextCache.size(), (size_t)OPTIMIZER_CACHE_SIZE));
+		cache.swap(nextCache);
+
+		best = -1;
+		float bestScore = -FLT_MAX;
+		for (GLuint v : cache) {
+			const unsigned int * list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++) {
+				if (triangleScore[list[j]] > bestScore) {
+					bestScore = triangleScore[list[j]];
+					best = list[j];
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<GLuint> & indices, const float * positions, size_t vertexCount, size_t stride, float threshold) {
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) return;
+
+	// hard boundaries: triangles that miss the cache on all three vertices
+	// start a new cluster, moving them costs nothing in cache efficiency
+	std::vector<size_t> hard;
+	FifoCache fifo(vertexCount, ANALYZER_CACHE_SIZE);
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (fifo.triangle(&indices[3 * t]) == 3) hard.push_back(t);
+	}
+	hard.push_back(triangleCount);
+
+	// soft boundaries: cut a hard cluster again wherever its running ratio is
+	// back within threshold of the whole cluster's
+	std::vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hard.size(); c++) {
+		size_t begin = hard[c], end = hard[c + 1];
+		fifo.reset();
+		int misses = 0;
+		for (size_t t = begin; t < end; t++) misses += fifo.triangle(&indices[3 * t]);
+		float limit = (float)misses / (end - begin) * threshold;
+
+		fifo.reset();
+		clusters.push_back(begin);
+		size_t start = begin;
+		misses = 0;
+		for (size_t t = begin; t + 1 < end; t++) {
+			misses += fifo.triangle(&indices[3 * t]);
+			if ((float)misses / (t - start + 1) <= limit) {
+				clusters.push_back(t + 1);
+				fifo.reset();
+				start = t + 1;
+				misses = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+	size_t clusterCount = clusters.size() - 1;
+
+	// area weighted centroid and normal of each cluster and of the mesh
+	std::vector<float> centroids(clusterCount * 3, 0.0f), normals(clusterCount * 3, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f }, meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++) {
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			const float * a = position(positions, stride, indices[3 * t]);
+			const float * b = position(positions, stride, indices[3 * t + 1]);
+			const float * d = position(positions, stride, indices[3 * t + 2]);
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float w = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++) {
+				centroids[3 * c + k] += (a[k] + b[k] + d[k]) * w / 3.0f;
+				normals[3 * c + k] += n[k];
+			}
+			area += w;
+		}
+		for (int k = 0; k < 3; k++) meshCentroid[k] += centroids[3 * c + k];
+		meshArea += area;
+		if (area > 0.0f) for (int k = 0; k < 3; k++) centroids[3 * c + k] /= area;
+	}
+	if (meshArea > 0.0f) for (int k = 0; k < 3; k++) meshCentroid[k] /= meshArea;
+
+	// clusters facing out of the mesh first
+	std::vector<float> key(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		const float * n = &normals[3 * c];
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float d = 0.0f;
+		for (int k = 0; k < 3; k++) d += (centroids[3 * c + k] - meshCentroid[k]) * n[k];
+		key[c] = length > 0.0f ? d / length : 0.0f;
+	}
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return key[a] > key[b]; });
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t c : order) {
+		result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+	}
+	indices.swap(result);
+}
+
+std::vector<GLuint> optimizeVertexFetchRemap(std::vector<GLuint> & indices, size_t vertexCount) {
+	std::vector<GLuint> remap(vertexCount, REMAP_NONE);
+	GLuint next = 0;
+	for (GLuint & v : indices) {
+		if (remap[v] == REMAP_NONE) remap[v] = next++;
+		v = remap[v];
+	}
+	return remap;
+}
+
+MeshStats analyzeMesh(const std::vector<GLuint> & indices, const float * positions, size_t vertexCount, size_t stride) {
+	MeshStats stats = { 0.0f, 0.0f, 0.0f };
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return stats;
+
+	FifoCache fifo(vertexCount, ANALYZER_CACHE_SIZE);
+	size_t misses = 0;
+	for (size_t t = 0; t < triangleCount; t++) misses += fifo.triangle(&indices[3 * t]);
+
+	std::vector<char> used(vertexCount, 0);
+	size_t usedCount = 0;
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (GLuint v : indices) {
+		if (used[v]) continue;
+		used[v] = 1;
+		usedCount++;
+		const float * p = position(positions, stride, v);
+		for (int k = 0; k < 3; k++) {
+			lo[k] = std::min(lo[k], p[k]);
+			hi[k] = std::max(hi[k], p[k]);
+		}
+	}
+
+	stats.acmr = (float)misses / triangleCount;
+	stats.atvr = (float)misses / usedCount;
+
+	// seen along each axis from both sides with back faces culled, views that
+	// see no front face do not count
+	int views = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		for (float sign = -1.0f; sign <= 1.0f; sign += 2.0f) {
+			float overdraw = rasterizeOverdraw(indices, positions, stride, lo, hi, axis, sign);
+			if (overdraw > 0.0f) {
+				stats.overdraw += overdraw;
+				views++;
+			}
+		}
+	}
+	if (views > 0) stats.overdraw /= views;
+	return stats;
+}
+
+void optimizeMesh(ObjMesh & mesh, MeshStats * before, MeshStats * after) {
+	if (mesh.vertices.empty()) return;
+	const size_t stride = sizeof(ObjVertex);
+
+	if (before != NULL) *before = analyzeMesh(mesh.indices, &mesh.vertices[0].position.x, mesh.vertices.size(), stride);
+
+	optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	optimizeOverdraw(mesh.indices, &mesh.vertices[0].position.x, mesh.vertices.size(), stride);
+	remapVertices(mesh.vertices, optimizeVertexFetchRemap(mesh.indices, mesh.vertices.size()));
+
+	if (after != NULL) *after = analyzeMesh(mesh.indices, &mesh.vertices[0].position.x, mesh.vertices.size(), stride);
+}
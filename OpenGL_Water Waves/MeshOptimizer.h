@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+struct ObjMesh;
+
+// Triangle and vertex ordering for the GPU. Every pass only permutes triangles or
+// vertices, the mesh renders the same through the usual VBO/IBO path.
+
+// Forsyth's greedy ordering for a 32 entry LRU post transform cache
+void optimizeVertexCache(std::vector<GLuint> & indices, size_t vertexCount);
+
+// Splits the cache ordered triangles in clusters and draws the clusters facing
+// away from the mesh centre first, so outer surfaces hide inner ones early.
+// Clusters are cut where the vertex cache ratio stays within threshold of the
+// cache optimised order. positions points to 3 floats every stride bytes.
+void optimizeOverdraw(std::vector<GLuint> & indices, const float * positions, size_t vertexCount, size_t stride, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use so fetches walk the buffer forward.
+// Returns the old to new vertex map, unused vertices map to 0xffffffff.
+std::vector<GLuint> optimizeVertexFetchRemap(std::vector<GLuint> & indices, size_t vertexCount);
+
+// Applies a remap of optimizeVertexFetchRemap to one vertex stream, dropping unused vertices
+template <typename T>
+void remapVertices(std::vector<T> & vertices, const std::vector<GLuint> & remap) {
+	size_t used = 0;
+	for (GLuint r : remap) if (r != 0xffffffffu && r + 1 > used) used = r + 1;
+	std::vector<T> result(used);
+	for (size_t i = 0; i < remap.size(); i++) {
+		if (remap[i] != 0xffffffffu) result[remap[i]] = vertices[i];
+	}
+	vertices.swap(result);
+}
+
+struct MeshStats {
+	float acmr;      // vertex shader runs per triangle, 16 entry FIFO cache
+	float atvr;      // vertex shader runs per vertex, 1 is ideal
+	float overdraw;  // fragments shaded per covered pixel, mean of 6 axis views, back faces culled
+};
+
+MeshStats analyzeMesh(const std::vector<GLuint> & indices, const float * positions, size_t vertexCount, size_t stride);
+
+// All three passes on a loaded mesh, with the statistics before and after when asked
+void optimizeMesh(ObjMesh & mesh, MeshStats * before = NULL, MeshStats * after = NULL);
+
+#endif __MESH_OPTIMIZER_H__
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "MicroBench.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Counting every allocation puts two atomic read-modify-writes on each one,
+// ThreadPool workers included, so only microbenchmark builds replace the
+// global allocator
+#ifdef OCEAN_MICROBENCH
+namespace {
+	std::atomic<unsigned long long> allocations(0);
+	std::atomic<unsigned long long> allocatedBytes(0);
+
+	void * countedAlloc(size_t size) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+		return malloc(size == 0 ? 1 : size);
+	}
+}
+
+// Replacing these four covers new, new[] and their nothrow forms
+void * operator new(size_t size) {
+	void * p = countedAlloc(size);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+	return countedAlloc(size);
+}
+
+void operator delete(void * p) noexcept {
+	free(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept {
+	free(p);
+}
+
+AllocationCount allocationCount() {
+	AllocationCount c;
+	c.count = allocations.load(std::memory_order_relaxed);
+	c.bytes = allocatedBytes.load(std::memory_order_relaxed);
+	return c;
+}
+
+bool allocationsCounted() {
+	return true;
+}
+#else
+AllocationCount allocationCount() {
+	AllocationCount c = { 0, 0 };
+	return c;
+}
+
+bool allocationsCounted() {
+	return false;
+}
+#endif
+
+void MicroBench::add(const char * name, std::function<void()> op, double itemsPerOp, const char * itemName) {
+	Case c;
+	c.name = name;
+	c.op = op;
+	c.itemsPerOp = itemsPerOp;
+	c.itemName = itemName;
+	cases.push_back(c);
+}
+
+std::vector<MicroBenchResult> MicroBench::run(const char * filter, double minBatchSeconds, int batches) {
+	typedef std::chrono::steady_clock clock;
+	std::vector<MicroBenchResult> results;
+
+	if (!allocationsCounted()) {
+		printf("Allocations are not counted, build the Microbench configuration for the allocation columns\n");
+	}
+	printf("%-32s %12s %14s %20s %10s %12s\n", "case", "calls", "ns/op", "throughput", "allocs/op", "bytes/op");
+	for (Case & c : cases) {
+		if (filter != NULL && c.name.find(filter) == std::string::npos) continue;
+
+		c.op(); // warm up caches, first time allocations and lazy initialisation
+
+		// grow the batch until it runs long enough to time
+		long long n = 1;
+		for (;;) {
+			clock::time_point start = clock::now();
+			for (long long i = 0; i < n; i++) c.op();
+			double seconds = std::chrono::duration<double>(clock::now() - start).count();
+			if (seconds >= minBatchSeconds || n >= (1LL << 40)) break;
+			n = seconds <= 0.0 ? n * 10 : std::max(n * 2, (long long)(n * minBatchSeconds * 1.2 / seconds));
+		}
+
+		std::vector<double> ns;
+		AllocationCount before = allocationCount();
+		for (int b = 0; b < batches; b++) {
+			clock::time_point start = clock::now();
+			for (long long i = 0; i < n; i++) c.op();
+			ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - start).count() / n);
+		}
+		AllocationCount after = allocationCount();
+		std::sort(ns.begin(), ns.end());
+
+		MicroBenchResult r;
+		r.name = c.name;
+		r.iterations = n * batches;
+		r.nsPerOp = ns[ns.size() / 2];
+		r.itemsPerSecond = c.itemsPerOp > 0.0 ? c.itemsPerOp * 1.0e9 / r.nsPerOp : 0.0;
+		r.itemName = c.itemName;
+		r.allocationsPerOp = (double)(after.count - before.count) / r.iterations;
+		r.bytesPerOp = (double)(after.bytes - before.bytes) / r.iterations;
+		results.push_back(r);
+
+		char throughput[64] = "";
+		if (r.itemsPerSecond > 0.0) {
+			double v = r.itemsPerSecond;
+			const char * unit = "";
+			if (v >= 1.0e9) { v /= 1.0e9; unit = "G"; }
+			else if (v >= 1.0e6) { v /= 1.0e6; unit = "M"; }
+			else if (v >= 1.0e3) { v /= 1.0e3; unit = "k"; }
+			snprintf(throughput, sizeof(throughput), "%.2f %s%s/s", v, unit, r.itemName.c_str());
+		}
+		printf("%-32s %12lld %14.1f %20s %10.2f %12.1f\n", r.name.c_str(), r.iterations, r.nsPerOp, throughput, r.allocationsPerOp, r.bytesPerOp);
+	}
+	return results;
+}
+
+bool MicroBench::writeJson(const char * path, const std::vector<MicroBenchResult> & results) {
+	FILE * file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Microbenchmark results %s could not be opened\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\"results\":[\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const MicroBenchResult & r = results[i];
+		fprintf(file, "{\"name\":\"%s\",\"iterations\":%lld,\"ns_per_op\":%.2f,\"items_per_second\":%.1f,\"item\":\"%s\",\"allocations_per_op\":%.3f,\"bytes_per_op\":%.1f}%s\n",
+			r.name.c_str(), r.iterations, r.nsPerOp, r.itemsPerSecond, r.itemName.c_str(), r.allocationsPerOp, r.bytesPerOp,
+			i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "]}\n");
+
+	bool ok = fclose(file) == 0;
+	if (!ok) printf("Microbenchmark results %s could not be written\n", path);
+	return ok;
+}
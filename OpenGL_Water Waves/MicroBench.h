@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef __MICRO_BENCH_H__
+#define __MICRO_BENCH_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Allocations made through operator new since the program started. Builds
+// with OCEAN_MICROBENCH defined (the Microbench configuration, or
+// -DOCEAN_MICROBENCH=ON with CMake) replace operator new in MicroBench.cpp
+// to count them with a relaxed atomic, other builds keep the default
+// allocator and always report 0.
+struct AllocationCount {
+	unsigned long long count;
+	unsigned long long bytes;
+};
+AllocationCount allocationCount();
+bool allocationsCounted();
+
+struct MicroBenchResult {
+	std::string name;
+	long long iterations;    // timed calls in total
+	double nsPerOp;          // median of the timed batches
+	double itemsPerSecond;   // 0 when the case has no item count
+	std::string itemName;
+	double allocationsPerOp;
+	double bytesPerOp;
+};
+
+// Times small CPU operations. Each case is called once to warm up, then in
+// batches sized to last at least minBatchSeconds, and the median batch is kept.
+class MicroBench {
+private:
+	struct Case {
+		std::string name;
+		std::function<void()> op;
+		double itemsPerOp;
+		std::string itemName;
+	};
+	std::vector<Case> cases;
+
+public:
+	// itemsPerOp scales the throughput column, like vertices or bytes per call
+	void add(const char * name, std::function<void()> op, double itemsPerOp = 0.0, const char * itemName = "");
+
+	// Runs the cases whose name contains filter (all if NULL) and prints a table
+	std::vector<MicroBenchResult> run(const char * filter, double minBatchSeconds = 0.1, int batches = 5);
+
+	static bool writeJson(const char * path, const std::vector<MicroBenchResult> & results);
+};
+
+#endif __MICRO_BENCH_H__
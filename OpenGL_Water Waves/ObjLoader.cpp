@@ -0,0 +1,270 @@
+#include "stdafx.h"
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Bytes parsed by one task, chunks end on a line break
+#define OBJ_CHUNK_BYTES (1 << 20)
+
+#define OBJ_NONE 0xffffffffu
+
+namespace {
+
+	struct Corner {
+		uint32_t v, vt, vn;   // 0 based, OBJ_NONE when the face omits it
+	};
+
+	struct Chunk {
+		const char * begin;
+		const char * end;
+
+		// attribute lines in the chunk, then the number before it
+		size_t positions, uvs, normals;
+		size_t positionBase, uvBase, normalBase;
+
+		std::vector<Corner> corners;   // 3 per triangle
+		std::string error;
+	};
+
+	inline bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char * skipSpaces(const char * p, const char * end) {
+		while (p < end && isSpace(*p)) p++;
+		return p;
+	}
+
+	inline const char * lineEnd(const char * p, const char * end) {
+		const char * eol = (const char *)memchr(p, '\n', end - p);
+		return eol == NULL ? end : eol;
+	}
+
+	// Line kinds that declare an attribute, 0 for anything else
+	inline char attributeKind(const char * p, const char * eol) {
+		p = skipSpaces(p, eol);
+		if (eol - p < 2 || p[0] != 'v') return 0;
+		if (isSpace(p[1])) return 'v';
+		if ((p[1] == 't' || p[1] == 'n') && (eol - p == 2 || isSpace(p[2]))) return p[1];
+		return 0;
+	}
+
+	const char * parseFloats(const char * p, const char * eol, float * out, int count) {
+		for (int i = 0; i < count; i++) {
+			p = skipSpaces(p, eol);
+			if (p < eol && *p == '+') p++;
+			std::from_chars_result r = std::from_chars(p, eol, out[i]);
+			if (r.ec != std::errc()) return NULL;
+			p = r.ptr;
+		}
+		return p;
+	}
+
+	// One of v, v/vt, v//vn or v/vt/vn, resolved against the attributes read so far
+	bool parseCorner(const char *& p, const char * eol, const size_t read[3], const size_t total[3], Corner & corner) {
+		uint32_t * fields[3] = { &corner.v, &corner.vt, &corner.vn };
+		corner.v = corner.vt = corner.vn = OBJ_NONE;
+
+		for (int f = 0; f < 3; f++) {
+			if (f > 0) {
+				if (p >= eol || *p != '/') break;
+				p++;
+				if (p < eol && (*p == '/' || isSpace(*p))) continue; // empty field
+			}
+			long long index;
+			std::from_chars_result r = std::from_chars(p, eol, index);
+			if (r.ec != std::errc() || index == 0) return false;
+			p = r.ptr;
+
+			long long resolved = index > 0 ? index - 1 : (long long)read[f] + index;
+			if (resolved < 0 || resolved >= (long long)total[f]) return false;
+			*fields[f] = (uint32_t)resolved;
+		}
+		return corner.v != OBJ_NONE;
+	}
+
+	void countAttributes(Chunk & chunk) {
+		chunk.positions = chunk.uvs = chunk.normals = 0;
+		for (const char * p = chunk.begin; p < chunk.end; ) {
+			const char * eol = lineEnd(p, chunk.end);
+			switch (attributeKind(p, eol)) {
+			case 'v': chunk.positions++; break;
+			case 't': chunk.uvs++; break;
+			case 'n': chunk.normals++; break;
+			}
+			p = eol + 1;
+		}
+	}
+
+	void parseChunk(Chunk & chunk, const size_t total[3], glm::vec3 * positions, glm::vec2 * uvs, glm::vec3 * normals) {
+		size_t read[3] = { chunk.positionBase, chunk.uvBase, chunk.normalBase };
+		std::vector<Corner> polygon;
+
+		for (const char * p = chunk.begin; p < chunk.end; ) {
+			const char * eol = lineEnd(p, chunk.end);
+			const char * q = skipSpaces(p, eol);
+			char kind = attributeKind(q, eol);
+
+			if (kind == 'v') {
+				if (parseFloats(q + 1, eol, &positions[read[0]++].x, 3) == NULL) chunk.error = "bad vertex position";
+			}
+			else if (kind == 't') {
+				// v defaults to 0, a third coordinate is ignored
+				glm::vec2 & uv = uvs[read[1]++];
+				const char * r = parseFloats(q + 2, eol, &uv.x, 1);
+				if (r == NULL) chunk.error = "bad texture coordinate";
+				else if (skipSpaces(r, eol) == eol) uv.y = 0.0f;
+				else if (parseFloats(r, eol, &uv.y, 1) == NULL) chunk.error = "bad texture coordinate";
+			}
+			else if (kind == 'n') {
+				if (parseFloats(q + 2, eol, &normals[read[2]++].x, 3) == NULL) chunk.error = "bad normal";
+			}
+			else if (eol - q >= 2 && q[0] == 'f' && isSpace(q[1])) {
+				polygon.clear();
+				q = skipSpaces(q + 1, eol);
+				while (q < eol) {
+					Corner corner;
+					if (!parseCorner(q, eol, read, total, corner)) {
+						chunk.error = "bad or out of range face index";
+						break;
+					}
+					polygon.push_back(corner);
+					q = skipSpaces(q, eol);
+				}
+				if (chunk.error.empty() && polygon.size() < 3) chunk.error = "face with less than 3 vertices";
+
+				for (size_t i = 2; i < polygon.size() && chunk.error.empty(); i++) {
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i - 1]);
+					chunk.corners.push_back(polygon[i]);
+				}
+			}
+
+			if (!chunk.error.empty()) return;
+			p = eol + 1;
+		}
+	}
+
+	inline uint32_t hashCorner(const Corner & c) {
+		uint32_t h = c.v * 0x9E3779B1u ^ c.vt * 0x85EBCA77u ^ c.vn * 0xC2B2AE3Du;
+		h ^= h >> 16;
+		h *= 0x7FEB352Du;
+		h ^= h >> 15;
+		return h;
+	}
+}
+
+bool loadObjMesh(const char * path, ObjMesh & mesh) {
+	return loadObjMesh(path, mesh, ThreadPool::shared());
+}
+
+bool loadObjMesh(const char * path, ObjMesh & mesh, ThreadPool & pool) {
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.hasUvs = mesh.hasNormals = false;
+
+	MappedFile file(path);
+	if (!file.isOpen()) {
+		printf("OBJ %s could not be opened\n", path);
+		return false;
+	}
+
+	// split on line breaks, a few chunks per thread so uneven ones balance out
+	const char * data = (const char *)file.data();
+	const char * end = data + file.size();
+	size_t chunkBytes = std::max((size_t)OBJ_CHUNK_BYTES, file.size() / (4 * (pool.size() + 1)) + 1);
+	std::vector<Chunk> chunks;
+	for (const char * p = data; p < end; ) {
+		Chunk chunk;
+		chunk.begin = p;
+		chunk.end = end - p > (ptrdiff_t)chunkBytes ? lineEnd(p + chunkBytes, end) : end;
+		chunks.push_back(chunk);
+		p = chunk.end + 1;
+	}
+	int n = (int)chunks.size();
+
+	// first pass counts attributes, so every chunk knows where its own start
+	// and the absolute value of negative indices
+	pool.parallelFor(0, n, 1, [&](int first, int last) {
+		for (int c = first; c < last; c++) countAttributes(chunks[c]);
+	});
+	size_t total[3] = { 0, 0, 0 };
+	for (Chunk & chunk : chunks) {
+		chunk.positionBase = total[0];
+		chunk.uvBase = total[1];
+		chunk.normalBase = total[2];
+		total[0] += chunk.positions;
+		total[1] += chunk.uvs;
+		total[2] += chunk.normals;
+	}
+
+	std::vector<glm::vec3> positions(total[0]);
+	std::vector<glm::vec2> uvs(total[1]);
+	std::vector<glm::vec3> normals(total[2]);
+	pool.parallelFor(0, n, 1, [&](int first, int last) {
+		for (int c = first; c < last; c++) parseChunk(chunks[c], total, positions.data(), uvs.data(), normals.data());
+	});
+
+	size_t corners = 0;
+	for (const Chunk & chunk : chunks) {
+		if (!chunk.error.empty()) {
+			printf("OBJ %s: %s\n", path, chunk.error.c_str());
+			return false;
+		}
+		corners += chunk.corners.size();
+	}
+	if (corners == 0) {
+		printf("OBJ %s has no faces\n", path);
+		return false;
+	}
+
+	// one vertex per distinct triplet, open addressing with linear probing
+	size_t capacity = 16;
+	while (capacity < 2 * std::min(corners, (size_t)OBJ_NONE / 2)) capacity *= 2;
+	std::vector<uint32_t> table(capacity, OBJ_NONE);
+	std::vector<Corner> unique;
+	unique.reserve(std::max(total[0], corners / 6));
+	mesh.indices.reserve(corners);
+
+	bool uvsUsed = false, normalsUsed = false;
+	for (const Chunk & chunk : chunks) {
+		for (const Corner & corner : chunk.corners) {
+			size_t slot = hashCorner(corner) & (capacity - 1);
+			for (;;) {
+				uint32_t index = table[slot];
+				if (index == OBJ_NONE) {
+					index = table[slot] = (uint32_t)unique.size();
+					unique.push_back(corner);
+					uvsUsed |= corner.vt != OBJ_NONE;
+					normalsUsed |= corner.vn != OBJ_NONE;
+				}
+				const Corner & u = unique[index];
+				if (u.v == corner.v && u.vt == corner.vt && u.vn == corner.vn) {
+					mesh.indices.push_back(index);
+					break;
+				}
+				slot = (slot + 1) & (capacity - 1);
+			}
+		}
+	}
+
+	mesh.vertices.resize(unique.size());
+	pool.parallelFor(0, (int)unique.size(), 1 << 14, [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			const Corner & c = unique[i];
+			ObjVertex & v = mesh.vertices[i];
+			v.position = positions[c.v];
+			v.uv = c.vt != OBJ_NONE ? uvs[c.vt] : glm::vec2(0.0f);
+			v.normal = c.vn != OBJ_NONE ? normals[c.vn] : glm::vec3(0.0f);
+		}
+	});
+	mesh.hasUvs = uvsUsed;
+	mesh.hasNormals = normalsUsed;
+	return true;
+}
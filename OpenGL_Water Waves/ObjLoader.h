@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef __OBJ_LOADER_H__
+#define __OBJ_LOADER_H__
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class ThreadPool;
+
+// Interleaved vertex, 32 bytes
+struct ObjVertex {
+	glm::vec3 position;
+	glm::vec2 uv;
+	glm::vec3 normal;
+};
+
+// Indexed triangle mesh, ready for glBufferData and GL_UNSIGNED_INT draws
+struct ObjMesh {
+	std::vector<ObjVertex> vertices;
+	std::vector<GLuint> indices;
+	bool hasUvs;     // uv and normal are zero when the file has none
+	bool hasNormals;
+};
+
+// Loads a Wavefront OBJ into one indexed mesh. Faces may be polygons, which are
+// fanned into triangles, in any of the v, v/vt, v//vn and v/vt/vn forms, with
+// negative indices counting back from the last attribute read. Groups,
+// materials and smoothing are ignored.
+//
+// The file is mapped and parsed in line aligned chunks on the pool. Each
+// distinct v/vt/vn triplet becomes one vertex, so no indexVBO pass is needed.
+bool loadObjMesh(const char * path, ObjMesh & mesh, ThreadPool & pool);
+bool loadObjMesh(const char * path, ObjMesh & mesh);
+
+#endif __OBJ_LOADER_H__
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "OceanGBuffer.h"
+
+OceanGBuffer::OceanGBuffer()
+	: fbo{ 0 }, normals{ 0 }, variance{ 0 }, depth{ 0 }, program{ 0 }, w{ 0 }, h{ 0 },
+	rate{ BANDS_HALF }, gbufferWidth{ 0 }, gbufferHeight{ 0 } {}
+
+OceanGBuffer::~OceanGBuffer() {
+	destroy();
+}
+
+static GLuint createAttachment(GLenum internalFormat, int width, int height) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+bool OceanGBuffer::create(int width, int height) {
+	destroy();
+
+	// rounded up, the last texels cover the edge pixels
+	int gw = (width + BANDS_HALF - 1) / BANDS_HALF;
+	int gh = (height + BANDS_HALF - 1) / BANDS_HALF;
+
+	normals = createAttachment(GL_RGBA16F, gw, gh);
+	variance = createAttachment(GL_RG16F, gw, gh);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, gw, gh);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	static const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normals, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, variance, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	glDrawBuffers(2, buffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Ocean G-buffer %dx%d is incomplete (0x%x)\n", gw, gh, status);
+		destroy();
+		return false;
+	}
+
+	w = gw;
+	h = gh;
+	return true;
+}
+
+void OceanGBuffer::destroy() {
+	if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+	if (normals != 0) glDeleteTextures(1, &normals);
+	if (variance != 0) glDeleteTextures(1, &variance);
+	if (depth != 0) glDeleteRenderbuffers(1, &depth);
+	fbo = normals = variance = depth = 0;
+	w = h = 0;
+}
+
+void OceanGBuffer::begin(int renderWidth, int renderHeight) {
+	gbufferWidth = (renderWidth + BANDS_HALF - 1) / BANDS_HALF;
+	gbufferHeight = (renderHeight + BANDS_HALF - 1) / BANDS_HALF;
+
+	// a zero distance marks the texels no ocean fragment reached
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, gbufferWidth, gbufferHeight);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void OceanGBuffer::setOceanUniforms(GLuint ocean) {
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, normals);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + 1);
+	glBindTexture(GL_TEXTURE_2D, variance);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(glGetUniformLocation(ocean, "gbufferFactor"), BANDS_HALF);
+	glUniform1i(glGetUniformLocation(ocean, "bandNormals"), GBUFFER_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(ocean, "bandVariance"), GBUFFER_TEXTURE_UNIT + 1);
+	glUniform2i(glGetUniformLocation(ocean, "gbufferSize"), gbufferWidth, gbufferHeight);
+	glUniform1f(glGetUniformLocation(ocean, "fullRateDistance"), GBUFFER_FULL_RATE_DISTANCE);
+	glUniform1f(glGetUniformLocation(ocean, "quarterRateDistance"), getQuarterRateDistance());
+}
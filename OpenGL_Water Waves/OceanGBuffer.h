@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef __OCEAN_GBUFFER_H__
+#define __OCEAN_GBUFFER_H__
+
+#include <GL/glew.h>
+
+// Pixels per side of the coarsest band loop sample; at full rate every pixel
+// runs the band loop itself, at half rate one G-buffer texel covers 2x2
+// pixels, and at quarter rate the texels past GBUFFER_QUARTER_RATE_DISTANCE
+// stand for a 2x2 block of their neighbours
+enum BandRate { BANDS_FULL = 1, BANDS_HALF = 2, BANDS_QUARTER = 4 };
+
+// First of the two texture units the ocean lighting pass reads the G-buffer
+// from, after the temporal resolve's
+#define GBUFFER_TEXTURE_UNIT 11
+
+// Pixels closer than this many meters to the camera run the band loop at full
+// rate, the short waves there span several pixels
+#define GBUFFER_FULL_RATE_DISTANCE 40.0f
+
+// At quarter rate, G-buffer texels farther than this many meters run the band
+// loop for one texel of each 2x2 block, the waves there fold into fewer pixels
+#define GBUFFER_QUARTER_RATE_DISTANCE 200.0f
+
+// Quarter rate distance of the half rate, past anything the targets can hold
+#define GBUFFER_NO_QUARTER_RATE 1e9f
+
+// Reduced rate band loop of the ocean. The grid is drawn first into a G-buffer
+// at 1/2 of the render size, where ocean_gbuffer.fs.glsl refines the normal
+// and slope variance with the waves between a G-buffer texel and a grid cell.
+// At quarter rate the rate is picked per texel from its distance: past the
+// quarter rate distance only the even texels of each 2x2 block run the loop,
+// for a texel twice as wide. The full resolution ocean pass then lights each
+// pixel past the full rate distance with a bilateral upsample of the four
+// texels around it, on the even texels alone past the quarter rate distance,
+// weighted by their distance to the camera so the sky and nearer crests do
+// not bleed into it. Pixels without a matching texel run the loop themselves.
+//
+// Targets are allocated for the framebuffer size, scaled frames use a corner.
+class OceanGBuffer {
+private:
+	GLuint fbo;
+	GLuint normals;  // RGBA16F: wind space normal, distance (0 where nothing was drawn)
+	GLuint variance; // RG16F: slope variance in wind space
+	GLuint depth;
+	GLuint program;
+	int w, h;
+
+	BandRate rate;
+	int gbufferWidth, gbufferHeight; // texels used by the current frame
+
+public:
+	OceanGBuffer();
+	~OceanGBuffer();
+
+	OceanGBuffer(const OceanGBuffer &) = delete;
+	OceanGBuffer & operator=(const OceanGBuffer &) = delete;
+
+	// Allocates the targets for a width x height framebuffer
+	bool create(int width, int height);
+	void destroy();
+
+	void setShader(GLuint program) { this->program = program; }
+	GLuint getShader() const { return program; }
+	void setRate(BandRate rate) { this->rate = rate; }
+	BandRate getRate() const { return rate; }
+
+	// Distance past which texels run the loop at quarter rate
+	float getQuarterRateDistance() const { return rate == BANDS_QUARTER ? GBUFFER_QUARTER_RATE_DISTANCE : GBUFFER_NO_QUARTER_RATE; }
+
+	// Binds and clears the G-buffer, the viewport covers renderWidth x
+	// renderHeight divided by 2, rounded up
+	void begin(int renderWidth, int renderHeight);
+
+	// Binds the G-buffer textures and sets the upsampling uniforms of the
+	// ocean lighting program
+	void setOceanUniforms(GLuint ocean);
+
+	// Whether the targets match a width x height framebuffer
+	bool fits(int width, int height) const { return fbo != 0 && (width + BANDS_HALF - 1) / BANDS_HALF == w && (height + BANDS_HALF - 1) / BANDS_HALF == h; }
+};
+
+#endif __OCEAN_GBUFFER_H__
@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "OceanGrid.h"
+#include <cmath>
+
+namespace {
+	const float vmargin = 0.12f;
+	const float hmargin = 0.12f;
+
+	// Rows extend up to s * height, further up when looking at the horizon
+	float gridTop(float theta) {
+		float horizon = tan(theta);
+		return std::fmin(1.5f, 0.5f + horizon * 0.6f);
+	}
+}
+
+int fillGridVertices(int width, int height, int gridSize, float theta, std::vector<glm::vec4> & vertices) {
+	float s = gridTop(theta);
+	vertices.resize(int(ceil(height * (s + vmargin) / gridSize) + 5) * int(ceil(width * (1.0 + 2.0 * hmargin) / gridSize) + 5));
+
+	int n = 0;
+	int nx = 0;
+	for (float j = height * s - 0.1; j > -height * vmargin - gridSize; j -= gridSize) {
+		nx = 0;
+		for (float i = -width * hmargin; i < width * (1.0 + hmargin) + gridSize; i += gridSize) {
+			vertices[n++] = glm::vec4(-1.0 + 2.0 * i / width, -1.0 + 2.0 * j / height, 0.0, 1.0);
+			nx++;
+		}
+	}
+	vertices.resize(n);
+	return nx;
+}
+
+void fillGridIndices(int width, int height, int gridSize, float theta, int nx, std::vector<GLuint> & indices) {
+	float s = gridTop(theta);
+	indices.resize(6 * int(ceil(height * (s + vmargin) / gridSize) + 4) * int(ceil(width * (1.0 + 2.0 * hmargin) / gridSize) + 4));
+
+	int n = 0;
+	int nj = 0;
+	for (float j = height * s - 0.1; j > -height * vmargin; j -= gridSize) {
+		int ni = 0;
+		for (float i = -width * hmargin; i < width * (1.0 + hmargin); i += gridSize) {
+			indices[n++] = ni + (nj + 1) * nx;
+			indices[n++] = (ni + 1) + (nj + 1) * nx;
+			indices[n++] = (ni + 1) + nj * nx;
+			indices[n++] = (ni + 1) + nj * nx;
+			indices[n++] = ni + (nj + 1) * nx;
+			indices[n++] = ni + nj * nx;
+			ni++;
+		}
+		nj++;
+	}
+	indices.resize(n);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#ifndef __OCEAN_GRID_H__
+#define __OCEAN_GRID_H__
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Screen space grid the ocean vertex shader projects onto the sea plane. The grid
+// covers the view below the horizon of a camera pitched by theta, with margins so
+// displaced vertices do not uncover the screen edges.
+
+// Fills vertices with clip space points, row by row from the horizon down, and
+// returns the number of vertices per row. Vectors are reused, so refilling one
+// of the same size does not allocate.
+int fillGridVertices(int width, int height, int gridSize, float theta, std::vector<glm::vec4> & vertices);
+
+// Two triangles per grid cell, for a grid of nx vertices per row
+void fillGridIndices(int width, int height, int gridSize, float theta, int nx, std::vector<GLuint> & indices);
+
+#endif __OCEAN_GRID_H__
@@ -0,0 +1,127 @@
+#include "stdafx.h"
+#include "RenderTarget.h"
+
+RenderTarget::RenderTarget() : fbo{ 0 }, color{ 0 }, depth{ 0 }, w{ 0 }, h{ 0 } {}
+
+RenderTarget::~RenderTarget() {
+	destroy();
+}
+
+bool RenderTarget::create(int width, int height, GLenum colorFormat) {
+	destroy();
+
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+	if (width <= 0 || height <= 0 || width > maxSize || height > maxSize) {
+		printf("Render target %dx%d is not supported (max %d)\n", width, height, maxSize);
+		return false;
+	}
+
+	glGenTextures(1, &color);
+	glBindTexture(GL_TEXTURE_2D, color);
+	glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Render target %dx%d is incomplete (0x%x)\n", width, height, status);
+		destroy();
+		return false;
+	}
+
+	w = width;
+	h = height;
+	return true;
+}
+
+void RenderTarget::destroy() {
+	if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+	if (color != 0) glDeleteTextures(1, &color);
+	if (depth != 0) glDeleteRenderbuffers(1, &depth);
+	fbo = color = depth = 0;
+	w = h = 0;
+}
+
+void RenderTarget::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, w, h);
+}
+
+LayeredRenderTarget::LayeredRenderTarget() : fbo{ 0 }, color{ 0 }, depth{ 0 }, w{ 0 }, h{ 0 }, n{ 0 } {}
+
+LayeredRenderTarget::~LayeredRenderTarget() {
+	destroy();
+}
+
+bool LayeredRenderTarget::create(int width, int height, int layers, GLenum colorFormat) {
+	destroy();
+
+	GLint maxSize = 0, maxLayers = 0;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (width <= 0 || height <= 0 || width > maxSize || height > maxSize || layers <= 0 || layers > maxLayers) {
+		printf("Layered render target %dx%dx%d is not supported (max %d, %d layers)\n", width, height, layers, maxSize, maxLayers);
+		return false;
+	}
+
+	glGenTextures(1, &color);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, color);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, colorFormat, width, height, layers);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color, 0, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Layered render target %dx%dx%d is incomplete (0x%x)\n", width, height, layers, status);
+		destroy();
+		return false;
+	}
+
+	w = width;
+	h = height;
+	n = layers;
+	return true;
+}
+
+void LayeredRenderTarget::destroy() {
+	if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+	if (color != 0) glDeleteTextures(1, &color);
+	if (depth != 0) glDeleteRenderbuffers(1, &depth);
+	fbo = color = depth = 0;
+	w = h = n = 0;
+}
+
+void LayeredRenderTarget::bindLayer(int layer) const {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color, 0, layer);
+	glViewport(0, 0, w, h);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef __RENDER_TARGET_H__
+#define __RENDER_TARGET_H__
+
+#include <GL/glew.h>
+
+// Framebuffer object with a color texture (RGBA8 unless asked otherwise) and a
+// depth renderbuffer, at any size independent of the window.
+class RenderTarget {
+private:
+	GLuint fbo;
+	GLuint color;
+	GLuint depth;
+	int w, h;
+
+public:
+	RenderTarget();
+	~RenderTarget();
+
+	RenderTarget(const RenderTarget &) = delete;
+	RenderTarget & operator=(const RenderTarget &) = delete;
+
+	bool create(int width, int height, GLenum colorFormat = GL_RGBA8);
+	void destroy();
+
+	// Binds the framebuffer and sets the viewport to cover it
+	void bind() const;
+
+	GLuint framebuffer() const { return fbo; }
+	GLuint colorTexture() const { return color; }
+	int width() const { return w; }
+	int height() const { return h; }
+};
+
+// The same with a GL_TEXTURE_2D_ARRAY color texture, one layer per view.
+// Views are drawn one after the other, so they share one depth renderbuffer.
+class LayeredRenderTarget {
+private:
+	GLuint fbo;
+	GLuint color;
+	GLuint depth;
+	int w, h, n;
+
+public:
+	LayeredRenderTarget();
+	~LayeredRenderTarget();
+
+	LayeredRenderTarget(const LayeredRenderTarget &) = delete;
+	LayeredRenderTarget & operator=(const LayeredRenderTarget &) = delete;
+
+	bool create(int width, int height, int layers, GLenum colorFormat = GL_RGBA8);
+	void destroy();
+
+	// Attaches layer as the color buffer, binds the framebuffer and sets the viewport
+	void bindLayer(int layer) const;
+
+	GLuint framebuffer() const { return fbo; }
+	GLuint colorTexture() const { return color; }
+	int width() const { return w; }
+	int height() const { return h; }
+	int layers() const { return n; }
+};
+
+#endif __RENDER_TARGET_H__
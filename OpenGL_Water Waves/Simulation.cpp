@@ -0,0 +1,253 @@
+#include "stdafx.h"
+#include "Simulation.h"
+#include "Trace.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+//Macros for waves generation
+#define srnd() (2*frandom(&seed) - 1)
+#define nbAngles 5 // even
+#define angle(i) (1.5*(((i)%nbAngles)/(float)(nbAngles/2)-1 ))
+#define dangle() (1.5/(float)(nbAngles/2))
+
+// WAVES GENERATION
+// ----------------------------------------------------------------------------
+
+
+//Functions to generate random numbers
+long lrandom(long *seed)
+{
+	*seed = (*seed * 1103515245 + 12345) & 0x7FFFFFFF;
+	return *seed;
+}
+
+float frandom(long *seed)
+{
+	long r = lrandom(seed) >> (31 - 24);
+	return r / (float)(1 << 24);
+}
+
+//Function to generate gaussian random numbers
+float grandom(float mean, float stdDeviation, long *seed)
+{
+	float x1, x2, w, y1;
+	// per thread, the simulation thread and the headless paths both draw waves
+	static thread_local float y2;
+	static thread_local int use_last = 0;
+
+	if (use_last) {
+		y1 = y2;
+		use_last = 0;
+	}
+	else {
+		do {
+			x1 = 2.0f * frandom(seed) - 1.0f;
+			x2 = 2.0f * frandom(seed) - 1.0f;
+			w = x1 * x1 + x2 * x2;
+		} while (w >= 1.0f);
+		w = sqrt((-2.0f * log(w)) / w);
+		y1 = x1 * w;
+		y2 = x2 * w;
+		use_last = 1;
+	}
+	return mean + y1 * stdDeviation;
+}
+
+
+
+void generateWaveSet(const WaveParams & params, WaveSet & waves)
+{
+	TRACE_SCOPE("generateWaves");
+	long seed = 1234567;
+	int nbWaves = std::min(params.count, SIM_MAX_WAVES);
+	float min = log(params.lambdaMin) / log(2.0f);
+	float max = log(params.lambdaMax) / log(2.0f);
+
+	waves.count = nbWaves;
+	waves.sigmaXsq = 0.0;
+	waves.sigmaYsq = 0.0;
+	waves.meanHeight = 0.0;
+	waves.heightVariance = 0.0;
+	waves.amplitudeMax = 0.0;
+
+	float Wa[nbAngles]; // normalised gaussian samples
+	int index[nbAngles]; // to hash angle order
+	float s = 0;
+	for (int i = 0; i < nbAngles; i++) {
+		index[i] = i;
+		float a = angle(i);
+		s += Wa[i] = exp(-0.5*a*a);
+	}
+	for (int i = 0; i < nbAngles; i++) {
+		Wa[i] /= s;
+	}
+
+	for (int i = 0; i < nbWaves; ++i) {
+		float x = i / (nbWaves - 1.0f);
+
+		//Find a wavelength in the range [Lambda(min), Lambda(max)] according to the wave index
+		float lambda = pow(2.0f, (1.0f - x) * min + x * max);
+
+		float ktheta = grandom(0.0f, 1.0f, &seed) * params.dispersion;
+
+		//Calculate K (wavenumber)
+		float knorm = 2.0f * PI / lambda;
+		//Angular frequency
+		float omega = sqrt(9.81f * knorm);
+		float amplitude; 
+
+		//Fractional part of the range [Lambda(min), Lambda(max)]
+		float step = (max - min) / (nbWaves - 1); // dlambda/di
+
+		//w0 = gravity / Wind'speed at 20m 
+		float omega0 = G / params.U0;
+
+		if ((i % (nbAngles)) == 0) { // scramble angle ordre
+			for (int k = 0; k < nbAngles; k++) {   // do N swap in indices
+				int n1 = lrandom(&seed) % nbAngles, n2 = lrandom(&seed) % nbAngles, n;
+				n = index[n1];
+				index[n1] = index[n2];
+				index[n2] = n;
+			}
+		}
+
+		ktheta = params.dispersion * (angle(index[(i) % nbAngles]) + 0.4*srnd()*dangle());
+		ktheta *= 1.0 / (1.0 + 40.0*pow(omega0 / omega, 4));
+
+		//Calculate the amplitude according to the energy distribution of gravity waves as a function of their frequency
+		amplitude = (8.1e-3*G*G) / pow(omega, 5) * exp(-0.74*pow(omega0 / omega, 4));
+		amplitude *= 0.5*sqrt(2 * PI * G / lambda) * nbAngles * step;
+		amplitude = 3 * params.heightMax*sqrt(amplitude);
+
+		if (amplitude > 1.0f / knorm) {
+			amplitude = 1.0f / knorm;
+		}
+		else if (amplitude < -1.0f / knorm) {
+			amplitude = -1.0f / knorm;
+		}
+
+		waves.amplitudes[i] = amplitude;
+		waves.omegas[i] = omega;
+		waves.kx[i] = knorm * cos(ktheta);
+		waves.ky[i] = knorm * sin(ktheta);
+		waves.sigmaXsq += pow(cos(ktheta), 2.0f) * (1.0 - sqrt(1.0 - knorm * knorm * amplitude * amplitude));
+		waves.sigmaYsq += pow(sin(ktheta), 2.0f) * (1.0 - sqrt(1.0 - knorm * knorm * amplitude * amplitude));
+		waves.meanHeight -= knorm * amplitude * amplitude * 0.5f;
+		waves.heightVariance += amplitude * amplitude * (2.0f - knorm * knorm * amplitude * amplitude) * 0.25f;
+		waves.amplitudeMax += fabs(amplitude);
+	}
+
+	float var = 4.0f;
+	waves.amplitudeMax = 2.0f * var * sqrt(waves.heightVariance);
+
+}
+
+// SIMULATION THREAD
+// ----------------------------------------------------------------------------
+
+Simulation::Simulation(const SimState & initial, double rate)
+	: state{ initial }, raising{ false }, lowering{ false }, rate{ rate }, running{ false } {
+	snapshots.reset(initial);
+}
+
+Simulation::~Simulation() {
+	stop();
+}
+
+void Simulation::start() {
+	if (running.exchange(true)) return;
+	thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+	running.store(false);
+	if (thread.joinable()) thread.join();
+}
+
+void Simulation::run() {
+#ifdef OCEAN_TRACE
+	Trace::setThreadName("simulation");
+#endif
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+	Clock::time_point next = Clock::now();
+
+	while (running.load(std::memory_order_acquire)) {
+		SimInput input;
+		while (inputs.pop(input)) {
+			apply(input);
+		}
+		step(1.0 / rate);
+
+		snapshots.writeBuffer() = state;
+		snapshots.publish();
+
+		// late steps run back to back until the simulation has caught up, after a
+		// long stall (a debugger, a suspended laptop) it resumes from now instead
+		next += period;
+		Clock::time_point now = Clock::now();
+		if (now - next > 8 * period) next = now;
+		std::this_thread::sleep_until(next);
+	}
+}
+
+// The keys the interactive view used to apply inline, the others stay with
+// the render thread
+void Simulation::apply(const SimInput & input) {
+	if (input.key == GLFW_KEY_PAGE_UP) {
+		raising = input.action != GLFW_RELEASE;
+		return;
+	}
+	if (input.key == GLFW_KEY_PAGE_DOWN) {
+		lowering = input.action != GLFW_RELEASE;
+		return;
+	}
+	if (input.action != GLFW_PRESS) {
+		return;
+	}
+
+	switch (input.key) {
+	case GLFW_KEY_UP:
+		state.cameraTheta = std::fmin(state.cameraTheta + 5.0f / 180.0f * PI, PI / 2.0f - 0.001f);
+		break;
+	case GLFW_KEY_DOWN:
+		state.cameraTheta = std::fmax(state.cameraTheta - 5.0f / 180.0 * PI, -PI / 4.0f + 0.0001f);
+		break;
+	case GLFW_KEY_LEFT:
+		state.cameraPhi = std::fmax(state.cameraPhi - 5.0 / 180 * PI, -PI / 2 + 0.001f);
+		break;
+	case GLFW_KEY_RIGHT:
+		state.cameraPhi = std::fmin(state.cameraPhi + 5.0 / 180 * PI, PI / 2 - 0.0001);
+		break;
+	case GLFW_KEY_W:
+		state.spectrum.U0 += 0.2;
+		generateWaveSet(state.spectrum, state.waves);
+		break;
+	case GLFW_KEY_S:
+		state.spectrum.U0 = std::fmax(1.0, state.spectrum.U0 - 0.2);
+		generateWaveSet(state.spectrum, state.waves);
+		break;
+	case GLFW_KEY_A:
+		state.waveDirection = std::fmax(0.0, state.waveDirection - 0.1);
+		break;
+	case GLFW_KEY_D:
+		state.waveDirection = std::fmin(6.3, state.waveDirection + 0.1);
+		break;
+	}
+}
+
+void Simulation::step(double dt) {
+	TRACE_SCOPE("Simulation::step");
+
+	if (raising) {
+		state.cameraHeight = std::fmin(200.0f, state.cameraHeight + SIM_CLIMB_RATE * (float)dt);
+	}
+	else if (lowering) {
+		state.cameraHeight = std::fmax(1.5f, state.cameraHeight - SIM_CLIMB_RATE * (float)dt);
+	}
+
+	state.step++;
+	state.time = state.step / rate;
+}
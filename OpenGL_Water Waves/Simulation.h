@@ -0,0 +1,113 @@
+#pragma once
+
+#ifndef __PI__
+#define __PI__ 
+#define PI 3.14159265358979323846264338327950288
+#endif __PI__
+
+#ifndef __G__
+#define __G__ 
+#define G 9.8196
+#endif __G__
+
+#ifndef __SIMULATION_H__
+#define __SIMULATION_H__
+
+#include "LockFree.h"
+#include <atomic>
+#include <thread>
+
+#define SIM_MAX_WAVES 60  // size of the wave arrays in the ocean shaders
+#define SIM_RATE 120.0    // steps per second of the simulation thread
+#define SIM_CLIMB_RATE 20.0f // m/s while Page Up or Page Down is held
+
+// Spectrum the waves are drawn from
+struct WaveParams {
+	int count;
+	float lambdaMin, lambdaMax; // wavelengths in m
+	float heightMax;
+	float U0;                   // wind speed at 20 m
+	float dispersion;
+};
+
+// Waves and their statistics, as the ocean shaders read them
+struct WaveSet {
+	int count;
+	float amplitudes[SIM_MAX_WAVES];
+	float omegas[SIM_MAX_WAVES];
+	float kx[SIM_MAX_WAVES];
+	float ky[SIM_MAX_WAVES];
+
+	float sigmaXsq, sigmaYsq;
+	float meanHeight;
+	float heightVariance;
+	float amplitudeMax;
+};
+
+// Random numbers of the wave generator, seeded by the caller
+long lrandom(long *seed);
+float frandom(long *seed);
+float grandom(float mean, float stdDeviation, long *seed);
+
+// Draws the waves of a spectrum, the same params always give the same waves
+void generateWaveSet(const WaveParams & params, WaveSet & waves);
+
+// Everything the simulation owns, one immutable snapshot per step
+struct SimState {
+	double time;        // seconds of simulation
+	unsigned long step;
+
+	float cameraTheta, cameraPhi, cameraHeight;
+	float sunTheta, sunPhi;
+	float waveDirection;
+
+	WaveParams spectrum;
+	WaveSet waves;
+};
+
+// A GLFW key event, forwarded from the callback
+struct SimInput {
+	int key;
+	int action;
+};
+
+// Steps a SimState at a fixed rate on its own thread. Input goes in through
+// post(), snapshots come out through latest(); the render thread never waits
+// on a step and a slow frame does not slow the simulation down.
+class Simulation {
+private:
+	SimState state;   // simulation thread only
+	bool raising, lowering;
+	double rate;
+
+	TripleBuffer<SimState> snapshots;
+	SpscQueue<SimInput, 256> inputs;
+
+	std::thread thread;
+	std::atomic<bool> running;
+
+	void run();
+	void apply(const SimInput & input);
+	void step(double dt);
+
+public:
+	Simulation(const SimState & initial, double rate = SIM_RATE);
+	~Simulation();
+
+	Simulation(const Simulation &) = delete;
+	Simulation & operator=(const Simulation &) = delete;
+
+	void start();
+	void stop();
+
+	// From the thread running the GLFW callbacks, false when the queue is full
+	bool post(const SimInput & input) { return inputs.push(input); }
+
+	// Newest snapshot, from the render thread
+	const SimState & latest() {
+		snapshots.update();
+		return snapshots.readBuffer();
+	}
+};
+
+#endif __SIMULATION_H__
@@ -0,0 +1,281 @@
+#include "stdafx.h"
+#include "Tables.h"
+#include "MappedFile.h"
+#include "Trace.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Payload starts on a 64 byte boundary so the mapping can be handed to the driver as is
+#define TABLE_PAYLOAD_ALIGN 64
+
+// Trailer of the legacy dumps: magic, width, height, 0, channels
+#define RAW_TABLE_MAGIC 0xCAFEBABE
+#define RAW_TABLE_TRAILER 20
+
+uint16_t floatToHalf(float f) {
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+
+	uint32_t sign = (x >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((x >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = x & 0x7FFFFF;
+
+	if (((x >> 23) & 0xFF) == 0xFF) { // Inf / NaN
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+	if (exponent >= 31) { // overflow, clamp to Inf
+		return (uint16_t)(sign | 0x7C00);
+	}
+	if (exponent <= 0) { // denormal or zero
+		if (exponent < -10) {
+			return (uint16_t)sign;
+		}
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		// round to nearest even
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t mid = 1u << (shift - 1);
+		if (rest > mid || (rest == mid && (half & 1))) half++;
+		return (uint16_t)(sign | half);
+	}
+
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // may carry into the exponent, which is correct
+	return (uint16_t)half;
+}
+
+float halfToFloat(uint16_t h) {
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+	uint32_t x;
+
+	if (exponent == 0) {
+		if (mantissa == 0) {
+			x = sign;
+		}
+		else { // normalise the denormal
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			x = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else if (exponent == 31) {
+		x = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+uint32_t tableChecksum(const void * data, size_t size) {
+	const unsigned char * p = (const unsigned char *)data;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+const void * validateTable(const void * file, size_t fileSize, unsigned int width, unsigned int height, unsigned int channels) {
+	return validateTable(file, fileSize, width, height, 1, channels);
+}
+
+const void * validateTable(const void * file, size_t fileSize, unsigned int width, unsigned int height, unsigned int depth, unsigned int channels) {
+	if (fileSize < sizeof(TableHeader)) {
+		printf("Table is too small to contain a header\n");
+		return NULL;
+	}
+
+	TableHeader header;
+	memcpy(&header, file, sizeof(header));
+
+	if (memcmp(header.magic, TABLE_MAGIC, 4) != 0 || header.version != TABLE_VERSION) {
+		printf("Not a table file or unsupported version\n");
+		return NULL;
+	}
+	if (header.format != TABLE_FLOAT16 || header.width != width || header.height != height ||
+		header.depth != depth || header.channels != channels) {
+		printf("Table has layout %ux%ux%ux%u (format %u), expected %ux%ux%ux%u half floats\n",
+			header.width, header.height, header.depth, header.channels, header.format, width, height, depth, channels);
+		return NULL;
+	}
+
+	size_t expected = (size_t)width * height * depth * channels * sizeof(uint16_t);
+	if (header.payloadSize != expected || (size_t)header.payloadOffset + header.payloadSize > fileSize) {
+		printf("Table payload is truncated\n");
+		return NULL;
+	}
+
+	const unsigned char * payload = (const unsigned char *)file + header.payloadOffset;
+	if (tableChecksum(payload, header.payloadSize) != header.checksum) {
+		printf("Table checksum mismatch\n");
+		return NULL;
+	}
+
+	return payload;
+}
+
+bool writeTable(const char * path, unsigned int width, unsigned int height, unsigned int channels, const float * data) {
+	return writeTable(path, width, height, 1, channels, data);
+}
+
+bool writeTable(const char * path, unsigned int width, unsigned int height, unsigned int depth, unsigned int channels, const float * data) {
+	size_t count = (size_t)width * height * depth * channels;
+	std::vector<uint16_t> halfs(count);
+	for (size_t i = 0; i < count; i++) {
+		halfs[i] = floatToHalf(data[i]);
+	}
+
+	TableHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TABLE_MAGIC, 4);
+	header.version = TABLE_VERSION;
+	header.format = TABLE_FLOAT16;
+	header.width = width;
+	header.height = height;
+	header.depth = depth;
+	header.channels = channels;
+	header.payloadOffset = TABLE_PAYLOAD_ALIGN;
+	header.payloadSize = (uint32_t)(count * sizeof(uint16_t));
+	header.checksum = tableChecksum(halfs.data(), header.payloadSize);
+
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Table %s could not be written\n", path);
+		return false;
+	}
+
+	unsigned char padding[TABLE_PAYLOAD_ALIGN] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(padding, TABLE_PAYLOAD_ALIGN - sizeof(header), 1, file) == 1 &&
+		fwrite(halfs.data(), header.payloadSize, 1, file) == 1;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok) {
+		printf("Table %s could not be written\n", path);
+		remove(path);
+	}
+	return ok;
+}
+
+bool convertRawTable(const char * rawPath, const char * tablePath, unsigned int width, unsigned int height, unsigned int channels) {
+	MappedFile raw(rawPath);
+	if (!raw.isOpen()) {
+		printf("Table %s could not be opened\n", rawPath);
+		return false;
+	}
+
+	size_t expected = (size_t)width * height * channels * sizeof(float);
+	if (raw.size() == expected + RAW_TABLE_TRAILER) {
+		uint32_t trailer[RAW_TABLE_TRAILER / 4];
+		memcpy(trailer, raw.data() + expected, sizeof(trailer));
+		if (trailer[0] != RAW_TABLE_MAGIC || trailer[1] != width || trailer[2] != height || trailer[4] != channels) {
+			printf("Table %s: trailer %08x describes %ux%u with %u channels, expected %ux%u with %u\n",
+				rawPath, trailer[0], trailer[1], trailer[2], trailer[4], width, height, channels);
+			return false;
+		}
+	}
+	else if (raw.size() != expected) {
+		printf("Table %s has %zu bytes, expected %zu\n", rawPath, raw.size(), expected);
+		return false;
+	}
+
+	// copy out of the mapping, it is not guaranteed to be float aligned on every platform
+	std::vector<float> data((size_t)width * height * channels);
+	memcpy(data.data(), raw.data(), expected);
+
+	return writeTable(tablePath, width, height, channels, data.data());
+}
+
+bool checkRawTable(const char * rawPath, unsigned int width, unsigned int height, unsigned int channels) {
+	std::string scratch = std::string(rawPath) + ".check.tbl";
+	if (!convertRawTable(rawPath, scratch.c_str(), width, height, channels)) {
+		return false;
+	}
+
+	MappedFile raw(rawPath), table(scratch.c_str());
+	const uint16_t * payload = table.isOpen() ? (const uint16_t *)validateTable(table.data(), table.size(), width, height, channels) : NULL;
+	bool ok = payload != NULL && raw.isOpen();
+
+	size_t count = (size_t)width * height * channels, mismatches = 0;
+	for (size_t i = 0; ok && i < count; i++) {
+		float expected;
+		memcpy(&expected, raw.data() + i * sizeof(float), sizeof(float));
+		float error = fabsf(halfToFloat(payload[i]) - expected);
+		if (!(error <= fabsf(expected) / 1024.0f + 1e-7f)) mismatches++;
+	}
+	ok = ok && mismatches == 0;
+
+	table.close();
+	remove(scratch.c_str());
+	if (payload == NULL) printf("Table %s: the converted table does not validate\n", rawPath);
+	else if (mismatches > 0) printf("Table %s: %zu of %zu texels differ after conversion\n", rawPath, mismatches, count);
+	else printf("Table %s: %ux%u, %u channels, ok\n", rawPath, width, height, channels);
+	return ok;
+}
+
+void uploadTable(GLuint texture, unsigned int width, unsigned int height, unsigned int channels, const void * payload) {
+	GLenum format = channels == 4 ? GL_RGBA : (channels == 3 ? GL_RGB : (channels == 2 ? GL_RG : GL_RED));
+	GLenum internalFormat = channels == 4 ? GL_RGBA16F : (channels == 3 ? GL_RGB16F : (channels == 2 ? GL_RG16F : GL_R16F));
+	GLsizeiptr size = (GLsizeiptr)width * height * channels * sizeof(uint16_t);
+
+	GLuint pbo;
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void * dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (dst != NULL) {
+		memcpy(dst, payload, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else { // mapping failed, let the driver copy from client memory
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, payload);
+	}
+
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_HALF_FLOAT, (void*)0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &pbo);
+}
+
+bool loadTableTexture(GLuint texture, const char * tablePath, const char * rawPath, unsigned int width, unsigned int height, unsigned int channels) {
+	TRACE_SCOPE("loadTableTexture");
+	MappedFile file(tablePath);
+	const void * payload = file.isOpen() ? validateTable(file.data(), file.size(), width, height, channels) : NULL;
+
+	if (payload == NULL && rawPath != NULL) {
+		file.close();
+		if (!convertRawTable(rawPath, tablePath, width, height, channels) || !file.open(tablePath)) {
+			return false;
+		}
+		payload = validateTable(file.data(), file.size(), width, height, channels);
+	}
+
+	if (payload == NULL) {
+		printf("Table %s could not be loaded\n", tablePath);
+		return false;
+	}
+
+	uploadTable(texture, width, height, channels, payload);
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef __TABLES_H__
+#define __TABLES_H__
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstddef>
+
+// Precomputed lookup tables (transmittance, sky irradiance, ...) are stored as
+//   TableHeader | payload (width * height * channels texels)
+// with the payload checksummed so a truncated or stale file is rejected
+// instead of being uploaded as garbage.
+
+#define TABLE_MAGIC "OTBL"
+#define TABLE_VERSION 1
+
+enum TableFormat { TABLE_FLOAT16 = 1, TABLE_FLOAT32 = 2 };
+
+struct TableHeader {
+	char     magic[4];
+	uint16_t version;
+	uint16_t format;        // TableFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;         // 1 for 2D tables
+	uint32_t channels;
+	uint32_t payloadOffset; // from the start of the file
+	uint32_t payloadSize;   // in bytes
+	uint32_t checksum;      // FNV-1a of the payload
+	uint32_t reserved;
+};
+
+uint16_t floatToHalf(float f);
+float halfToFloat(uint16_t h);
+
+uint32_t tableChecksum(const void * data, size_t size);
+
+// Validates the header of an in-memory table against the expected layout.
+// Returns a pointer to the payload, or NULL if anything does not match.
+const void * validateTable(const void * file, size_t fileSize, unsigned int width, unsigned int height, unsigned int channels);
+const void * validateTable(const void * file, size_t fileSize, unsigned int width, unsigned int height, unsigned int depth, unsigned int channels);
+
+// Converts float texels to half and writes a table file.
+bool writeTable(const char * path, unsigned int width, unsigned int height, unsigned int channels, const float * data);
+bool writeTable(const char * path, unsigned int width, unsigned int height, unsigned int depth, unsigned int channels, const float * data);
+
+// Converts a legacy float dump (transmittance.raw, irradiance.raw): the texels,
+// optionally followed by a 20 byte trailer 0xCAFEBABE, width, height, 0, channels
+// which has to match the expected layout.
+bool convertRawTable(const char * rawPath, const char * tablePath, unsigned int width, unsigned int height, unsigned int channels);
+
+// Converts rawPath to a scratch table, validates it and compares every texel with
+// the dump, within half precision. The scratch file is removed.
+bool checkRawTable(const char * rawPath, unsigned int width, unsigned int height, unsigned int channels);
+
+// Uploads a half-float table payload into a 2D texture through a pixel unpack buffer.
+void uploadTable(GLuint texture, unsigned int width, unsigned int height, unsigned int channels, const void * payload);
+
+// Maps tablePath and uploads it into texture. If the table is missing or invalid
+// and rawPath is given, the legacy raw file is converted first.
+bool loadTableTexture(GLuint texture, const char * tablePath, const char * rawPath, unsigned int width, unsigned int height, unsigned int channels);
+
+#endif __TABLES_H__
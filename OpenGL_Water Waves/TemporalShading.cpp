@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "TemporalShading.h"
+
+TemporalShading::TemporalShading()
+	: fbo{ 0 }, color{ 0 }, motion{ 0 }, depth{ 0 }, vao{ 0 }, program{ 0 }, w{ 0 }, h{ 0 },
+	pattern{ TEMPORAL_CHECKERBOARD }, renderWidth{ 0 }, renderHeight{ 0 }, current{ 0 }, valid{ false }, frame{ 0 },
+	previousMVP(1.0f), currentMVP(1.0f), previousCamera(0.0f), currentCamera(0.0f), previousTime{ 0.0 }, currentTime{ 0.0 } {}
+
+TemporalShading::~TemporalShading() {
+	destroy();
+}
+
+static GLuint createAttachment(GLenum internalFormat, int width, int height) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+bool TemporalShading::create(int width, int height) {
+	destroy();
+
+	if (!history[0].create(width, height, GL_RGBA16F) || !history[1].create(width, height, GL_RGBA16F)) {
+		destroy();
+		return false;
+	}
+
+	color = createAttachment(GL_RGBA8, width, height);
+	motion = createAttachment(GL_RGBA16F, width, height);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, motion, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Temporal shading target %dx%d is incomplete (0x%x)\n", width, height, status);
+		destroy();
+		return false;
+	}
+
+	glGenVertexArrays(1, &vao);
+
+	w = width;
+	h = height;
+	valid = false;
+	return true;
+}
+
+void TemporalShading::destroy() {
+	if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+	if (color != 0) glDeleteTextures(1, &color);
+	if (motion != 0) glDeleteTextures(1, &motion);
+	if (depth != 0) glDeleteRenderbuffers(1, &depth);
+	if (vao != 0) glDeleteVertexArrays(1, &vao);
+	fbo = color = motion = depth = vao = 0;
+	history[0].destroy();
+	history[1].destroy();
+	w = h = 0;
+	valid = false;
+}
+
+void TemporalShading::setPattern(TemporalPattern pattern) {
+	if (pattern != this->pattern) {
+		this->pattern = pattern;
+		valid = false;
+	}
+}
+
+void TemporalShading::begin(int renderWidth, int renderHeight, double time) {
+	// the history of another size does not line up with this frame
+	if (renderWidth != this->renderWidth || renderHeight != this->renderHeight) {
+		this->renderWidth = renderWidth;
+		this->renderHeight = renderHeight;
+		valid = false;
+	}
+	currentTime = time;
+
+	static const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glDrawBuffers(2, buffers);
+	glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void TemporalShading::setOceanUniforms(GLuint ocean, const glm::mat4 & mvp, const glm::vec3 & camera) {
+	currentMVP = mvp;
+	currentCamera = camera;
+
+	// without a history every pixel is shaded, the quad phases go diagonal first
+	static const int quadPhases[4] = { 0, 3, 1, 2 };
+	int phase = pattern == TEMPORAL_QUAD ? quadPhases[frame % 4] : (int)(frame % 2);
+
+	glUniform1i(glGetUniformLocation(ocean, "temporalPattern"), valid ? pattern : TEMPORAL_OFF);
+	glUniform1i(glGetUniformLocation(ocean, "temporalPhase"), phase);
+	glUniform1f(glGetUniformLocation(ocean, "previousTime"), (float)previousTime);
+	glUniformMatrix4fv(glGetUniformLocation(ocean, "previousMVP"), 1, GL_FALSE, &previousMVP[0][0]);
+	glUniform3f(glGetUniformLocation(ocean, "previousCamera"), previousCamera.x, previousCamera.y, previousCamera.z);
+}
+
+void TemporalShading::colorOnly() {
+	GLenum buffer = GL_COLOR_ATTACHMENT0;
+	glDrawBuffers(1, &buffer);
+}
+
+const RenderTarget & TemporalShading::resolve() {
+	RenderTarget & target = history[current];
+	const RenderTarget & previous = history[1 - current];
+
+	target.bind();
+	glViewport(0, 0, renderWidth, renderHeight);
+	glDisable(GL_DEPTH_TEST);
+
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0 + TEMPORAL_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, color);
+	glActiveTexture(GL_TEXTURE0 + TEMPORAL_TEXTURE_UNIT + 1);
+	glBindTexture(GL_TEXTURE_2D, motion);
+	glActiveTexture(GL_TEXTURE0 + TEMPORAL_TEXTURE_UNIT + 2);
+	glBindTexture(GL_TEXTURE_2D, previous.colorTexture());
+	glUniform1i(glGetUniformLocation(program, "sceneColor"), TEMPORAL_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "sceneMotion"), TEMPORAL_TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(program, "history"), TEMPORAL_TEXTURE_UNIT + 2);
+	glUniform2f(glGetUniformLocation(program, "historyScale"), (float)renderWidth / w, (float)renderHeight / h);
+	glUniform2i(glGetUniformLocation(program, "renderSize"), renderWidth, renderHeight);
+	glUniform1i(glGetUniformLocation(program, "historyValid"), valid);
+
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+	glEnable(GL_DEPTH_TEST);
+
+	// this frame is the next one's history
+	previousMVP = currentMVP;
+	previousCamera = currentCamera;
+	previousTime = currentTime;
+	current = 1 - current;
+	valid = true;
+	frame++;
+	return target;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef __TEMPORAL_SHADING_H__
+#define __TEMPORAL_SHADING_H__
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "RenderTarget.h"
+
+// Pixels shaded per frame: every one, 1 of 2 in a checkerboard, 1 of 4 in
+// 2x2 quads
+enum TemporalPattern { TEMPORAL_OFF, TEMPORAL_CHECKERBOARD, TEMPORAL_QUAD, NumTemporalPatterns };
+
+// First of the three texture units the resolve pass binds
+#define TEMPORAL_TEXTURE_UNIT 8
+
+// Beyond this many meters distances are clamped, the motion and history
+// targets are half floats
+#define TEMPORAL_MAX_DISTANCE 60000.0f
+
+// Temporal amortization of the ocean shading. The ocean draws into a scene
+// framebuffer with a second attachment for its motion: where each pixel's
+// surface point was on screen one frame earlier, and how far it was from the
+// camera then. waves.fs.glsl only shades the pixels of this frame's phase;
+// the resolve pass fills the others from the previous frame, clamped to the
+// colors of their shaded neighbours, or from the neighbours alone when the
+// history saw another surface there.
+//
+// Targets are allocated at the framebuffer size, scaled frames use a corner.
+class TemporalShading {
+private:
+	GLuint fbo;
+	GLuint color;  // RGBA8, shaded pixels
+	GLuint motion; // RGBA16F: previous uv, previous distance, distance (negative when not shaded)
+	GLuint depth;
+	RenderTarget history[2]; // resolved frames, distance in alpha
+	GLuint vao;              // empty, the resolve triangle comes from gl_VertexID
+	GLuint program;
+	int w, h;
+
+	TemporalPattern pattern;
+	int renderWidth, renderHeight;
+	int current;   // history written by the next resolve
+	bool valid;    // the other one holds the previous frame at this render size
+	unsigned long frame;
+
+	glm::mat4 previousMVP, currentMVP;
+	glm::vec3 previousCamera, currentCamera;
+	double previousTime, currentTime;
+
+public:
+	TemporalShading();
+	~TemporalShading();
+
+	TemporalShading(const TemporalShading &) = delete;
+	TemporalShading & operator=(const TemporalShading &) = delete;
+
+	bool create(int width, int height);
+	void destroy();
+
+	void setShader(GLuint program) { this->program = program; }
+	void setPattern(TemporalPattern pattern);
+	TemporalPattern getPattern() const { return pattern; }
+
+	// Binds the scene framebuffer with both attachments, the viewport covers
+	// renderWidth x renderHeight in its corner
+	void begin(int renderWidth, int renderHeight, double time);
+
+	// Temporal uniforms of the ocean program, for the view it is about to draw
+	void setOceanUniforms(GLuint ocean, const glm::mat4 & mvp, const glm::vec3 & camera);
+
+	// For passes that write no motion, the sky
+	void colorOnly();
+
+	// Fills the pixels left unshaded and keeps the result as the next frame's
+	// history. The frame is in the corner of the returned target.
+	const RenderTarget & resolve();
+
+	// The next frame shades every pixel, after a cut
+	void invalidate() { valid = false; }
+
+	int width() const { return w; }
+	int height() const { return h; }
+};
+
+#endif __TEMPORAL_SHADING_H__
@@ -0,0 +1,368 @@
+#include "stdafx.h"
+#include "TextureStreamer.h"
+#include "Image.h"
+#include "MappedFile.h"
+#include "Tables.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+
+// Rows in GL order, bottom first
+struct TextureStreamer::Source {
+	int width, height;
+	GLenum format, type;
+	size_t rowBytes;
+
+	virtual ~Source() {}
+	virtual const unsigned char * row(int y) const = 0;
+};
+
+struct TextureStreamer::Item {
+	enum State { Decoding, Ready, Uploading, Failed };
+
+	GLuint texture;
+	GLenum target;            // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+	GLenum internalFormat;
+	std::string path;
+	Callback onResident;
+	std::chrono::steady_clock::time_point requested;
+
+	State state;
+	bool cancelled;
+	std::vector<std::unique_ptr<Source>> layers; // NULL where decoding failed
+	int undecoded;
+
+	// upload in progress, rows are counted across layers
+	const Source * layout;
+	GLuint pbo;
+	unsigned char * mapped;
+	int rowsCopied;
+};
+
+namespace {
+
+	struct ImageSource : public TextureStreamer::Source {
+		Image image;
+
+		const unsigned char * row(int y) const { return image.row(y); }
+	};
+
+	struct TableSource : public TextureStreamer::Source {
+		MappedFile file;
+		const unsigned char * payload;
+
+		const unsigned char * row(int y) const { return payload + y * rowBytes; }
+	};
+
+	TextureStreamer::Source * loadImage(const std::string & path) {
+		ImageSource * source = new ImageSource;
+		if (!source->image.load(path.c_str())) {
+			delete source;
+			return NULL;
+		}
+		source->width = source->image.width();
+		source->height = source->image.height();
+		source->format = source->image.format();
+		source->type = source->image.type();
+		source->rowBytes = source->width * source->image.pixelSize();
+		return source;
+	}
+
+	// Same channels in the opposite order, the copy into the buffer swaps them
+	bool swapsRedBlue(GLenum a, GLenum b) {
+		return (a == GL_RGB && b == GL_BGR) || (a == GL_BGR && b == GL_RGB) ||
+			(a == GL_RGBA && b == GL_BGRA) || (a == GL_BGRA && b == GL_RGBA);
+	}
+
+	void copyRow(unsigned char * dst, const TextureStreamer::Source * layer, const TextureStreamer::Source & layout, int y) {
+		if (layer == NULL) {
+			memset(dst, 0, layout.rowBytes);
+		}
+		else if (layer->format == layout.format) {
+			memcpy(dst, layer->row(y), layout.rowBytes);
+		}
+		else {
+			const unsigned char * src = layer->row(y);
+			size_t pixel = layout.format == GL_RGB || layout.format == GL_BGR ? 3 : 4;
+			for (size_t x = 0; x < layout.rowBytes; x += pixel) {
+				dst[x] = src[x + 2];
+				dst[x + 1] = src[x + 1];
+				dst[x + 2] = src[x];
+				if (pixel == 4) dst[x + 3] = src[x + 3];
+			}
+		}
+	}
+}
+
+TextureStreamer::TextureStreamer(ThreadPool & pool) : pool(pool), decoding(0), created(std::chrono::steady_clock::now()) {
+}
+
+TextureStreamer::TextureStreamer() : TextureStreamer(ThreadPool::shared()) {
+}
+
+TextureStreamer::~TextureStreamer() {
+	// decode tasks hold their item, but not the streamer
+	std::unique_lock<std::mutex> lock(mutex);
+	decoded.wait(lock, [this] { return decoding == 0; });
+	for (const std::shared_ptr<Item> & item : items) {
+		if (item->state == Item::Uploading) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, item->pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &item->pbo);
+		}
+	}
+}
+
+std::shared_ptr<TextureStreamer::Item> TextureStreamer::newItem(GLuint texture, GLenum target, GLenum internalFormat, const char * path, Callback onResident, int layers) {
+	std::shared_ptr<Item> item = std::make_shared<Item>();
+	item->texture = texture;
+	item->target = target;
+	item->internalFormat = internalFormat;
+	item->path = path;
+	item->onResident = onResident;
+	item->requested = std::chrono::steady_clock::now();
+	item->state = Item::Decoding;
+	item->cancelled = false;
+	item->layers.resize(layers);
+	item->undecoded = layers;
+	item->layout = NULL;
+	item->pbo = 0;
+	item->mapped = NULL;
+	item->rowsCopied = 0;
+	return item;
+}
+
+void TextureStreamer::placeholder(const Item & item, const unsigned char * rgba) {
+	glBindTexture(item.target, item.texture);
+	if (item.target == GL_TEXTURE_2D_ARRAY) {
+		std::vector<unsigned char> texels;
+		for (size_t i = 0; i < item.layers.size(); i++) texels.insert(texels.end(), rgba, rgba + 4);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, (GLsizei)item.layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	}
+	else {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	}
+}
+
+void TextureStreamer::decode(std::shared_ptr<Item> item, const std::vector<std::function<Source *()>> & loads) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		items.push_back(item);
+		decoding += (int)loads.size();
+	}
+	for (size_t i = 0; i < loads.size(); i++) {
+		std::function<Source *()> load = loads[i];
+		pool.submit([this, item, load, i] {
+			TRACE_SCOPE("TextureStreamer::decode");
+			Source * source = load();
+			std::lock_guard<std::mutex> lock(mutex);
+			item->layers[i].reset(source);
+			if (--item->undecoded == 0) {
+				bool any = false;
+				for (const std::unique_ptr<Source> & layer : item->layers) any = any || layer;
+				item->state = any ? Item::Ready : Item::Failed;
+			}
+			decoding--;
+			decoded.notify_all();
+		});
+	}
+}
+
+void TextureStreamer::requestImage(GLuint texture, const char * path, GLenum internalFormat, const unsigned char placeholderRgba[4], Callback onResident) {
+	std::shared_ptr<Item> item = newItem(texture, GL_TEXTURE_2D, internalFormat, path, onResident, 1);
+	placeholder(*item, placeholderRgba);
+
+	std::string file = path;
+	decode(item, { [file] { return loadImage(file); } });
+}
+
+void TextureStreamer::requestImageArray(GLuint texture, const std::vector<std::string> & paths, GLenum internalFormat, const unsigned char placeholderRgba[4],
+	Callback onResident) {
+	std::string name = paths.empty() ? "" : paths[0] + (paths.size() > 1 ? " and " + std::to_string(paths.size() - 1) + " more" : "");
+	std::shared_ptr<Item> item = newItem(texture, GL_TEXTURE_2D_ARRAY, internalFormat, name.c_str(), onResident, (int)paths.size());
+	placeholder(*item, placeholderRgba);
+	if (paths.empty()) return;
+
+	std::vector<std::function<Source *()>> loads;
+	for (const std::string & file : paths) {
+		loads.push_back([file] { return loadImage(file); });
+	}
+	decode(item, loads);
+}
+
+void TextureStreamer::requestTable(GLuint texture, const char * tablePath, const char * rawPath, unsigned int width, unsigned int height, unsigned int channels,
+	const unsigned char placeholderRgba[4], Callback onResident) {
+	GLenum internalFormat = channels == 4 ? GL_RGBA16F : (channels == 3 ? GL_RGB16F : (channels == 2 ? GL_RG16F : GL_R16F));
+	std::shared_ptr<Item> item = newItem(texture, GL_TEXTURE_2D, internalFormat, tablePath, onResident, 1);
+	placeholder(*item, placeholderRgba);
+
+	std::string table = tablePath, raw = rawPath != NULL ? rawPath : "";
+	decode(item, { [table, raw, width, height, channels]() -> Source * {
+		TableSource * source = new TableSource;
+		// validation reads the whole payload for the checksum, off the GL thread
+		const void * payload = source->file.open(table.c_str()) ? validateTable(source->file.data(), source->file.size(), width, height, channels) : NULL;
+		if (payload == NULL && !raw.empty()) {
+			source->file.close();
+			if (convertRawTable(raw.c_str(), table.c_str(), width, height, channels) && source->file.open(table.c_str())) {
+				payload = validateTable(source->file.data(), source->file.size(), width, height, channels);
+			}
+		}
+		if (payload == NULL) {
+			printf("Table %s could not be loaded\n", table.c_str());
+			delete source;
+			return NULL;
+		}
+		source->payload = (const unsigned char *)payload;
+		source->width = width;
+		source->height = height;
+		source->format = channels == 4 ? GL_RGBA : (channels == 3 ? GL_RGB : (channels == 2 ? GL_RG : GL_RED));
+		source->type = GL_HALF_FLOAT;
+		source->rowBytes = (size_t)width * channels * sizeof(uint16_t);
+		return source;
+	} });
+}
+
+void TextureStreamer::cancel(GLuint texture) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const std::shared_ptr<Item> & item : items) {
+		if (item->texture == texture) item->cancelled = true;
+	}
+}
+
+void TextureStreamer::update(size_t byteBudget) {
+	TRACE_SCOPE("TextureStreamer::update");
+
+	// finished items leave the list under the lock, GL work happens outside it
+	std::vector<std::shared_ptr<Item>> work;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const std::shared_ptr<Item> & item : items) {
+			if (item->state != Item::Decoding) work.push_back(item);
+		}
+	}
+
+	std::vector<Item *> done;
+	for (const std::shared_ptr<Item> & item : work) {
+		if (item->state == Item::Failed || item->cancelled) {
+			if (item->state == Item::Failed && !item->cancelled) printf("Texture %s could not be streamed, keeping its placeholder\n", item->path.c_str());
+			if (item->state == Item::Uploading) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, item->pbo);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				glDeleteBuffers(1, &item->pbo);
+			}
+			done.push_back(item.get());
+			continue;
+		}
+
+		if (item->state == Item::Ready) {
+			// the first layer that loaded sets the size, others must match it
+			for (std::unique_ptr<Source> & layer : item->layers) {
+				if (!layer) continue;
+				if (item->layout == NULL) {
+					item->layout = layer.get();
+				}
+				else if (layer->width != item->layout->width || layer->height != item->layout->height || layer->type != item->layout->type ||
+					layer->rowBytes != item->layout->rowBytes || (layer->format != item->layout->format && !swapsRedBlue(layer->format, item->layout->format))) {
+					printf("Texture %s has layers of different sizes or formats, leaving one black\n", item->path.c_str());
+					layer.reset();
+				}
+			}
+
+			size_t size = item->layout->rowBytes * item->layout->height * item->layers.size();
+			glGenBuffers(1, &item->pbo);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, item->pbo);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+			item->mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			item->state = Item::Uploading;
+			if (item->mapped == NULL) {
+				printf("Texture %s could not map its upload buffer\n", item->path.c_str());
+				glDeleteBuffers(1, &item->pbo);
+				item->state = Item::Failed;
+				done.push_back(item.get());
+				continue;
+			}
+		}
+
+		// rows up to the budget, at least one so every texture makes progress,
+		// even those after the one that used the budget up
+		const Source & layout = *item->layout;
+		int total = layout.height * (int)item->layers.size();
+		size_t fit = std::max((size_t)1, byteBudget / layout.rowBytes);
+		int rows = (int)std::min(fit, (size_t)(total - item->rowsCopied));
+		for (int r = item->rowsCopied; r < item->rowsCopied + rows; r++) {
+			copyRow(item->mapped + r * layout.rowBytes, item->layers[r / layout.height].get(), layout, r % layout.height);
+		}
+		item->rowsCopied += rows;
+		byteBudget -= std::min(byteBudget, rows * layout.rowBytes);
+
+		if (item->rowsCopied == total) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, item->pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			// the frame's bindings stay as they were, whichever unit is active
+			GLint alignment, rowLength, bound;
+			glGetIntegerv(item->target == GL_TEXTURE_2D_ARRAY ? GL_TEXTURE_BINDING_2D_ARRAY : GL_TEXTURE_BINDING_2D, &bound);
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+			glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+			glBindTexture(item->target, item->texture);
+			if (item->target == GL_TEXTURE_2D_ARRAY) {
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, item->internalFormat, layout.width, layout.height, (GLsizei)item->layers.size(), 0,
+					layout.format, layout.type, (void*)0);
+			}
+			else {
+				glTexImage2D(GL_TEXTURE_2D, 0, item->internalFormat, layout.width, layout.height, 0, layout.format, layout.type, (void*)0);
+			}
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+			glBindTexture(item->target, bound);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &item->pbo);
+
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			printf("Texture %s resident %.0f ms after its request (%.0f ms after start up)\n", item->path.c_str(),
+				std::chrono::duration<double, std::milli>(now - item->requested).count(),
+				std::chrono::duration<double, std::milli>(now - created).count());
+			if (item->onResident) item->onResident();
+			done.push_back(item.get());
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!done.empty()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Item * d : done) {
+			for (size_t i = 0; i < items.size(); i++) {
+				if (items[i].get() == d) {
+					items.erase(items.begin() + i);
+					break;
+				}
+			}
+		}
+	}
+}
+
+void TextureStreamer::finish() {
+	while (pending() > 0) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			decoded.wait(lock, [this] {
+				for (const std::shared_ptr<Item> & item : items) {
+					if (item->state != Item::Decoding) return true;
+				}
+				return items.empty();
+			});
+		}
+		update((size_t)-1);
+	}
+}
+
+int TextureStreamer::pending() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return (int)items.size();
+}
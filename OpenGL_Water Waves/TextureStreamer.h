@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef __TEXTURE_STREAMER_H__
+#define __TEXTURE_STREAMER_H__
+
+#include <GL/glew.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Bytes of pixels copied into upload buffers per update() by default, about
+// 1 ms of memcpy. A 1024x1024 RGB image becomes resident one frame after decoding.
+#define TEXTURE_STREAM_BUDGET (8 << 20)
+
+// Loads textures in the background. A request puts a 1x1 placeholder in the
+// texture right away, decoding runs on the pool, and update() copies decoded
+// rows into a pixel unpack buffer within a byte budget per frame, or a single
+// row for each texture the budget does not reach. Once all rows are in, the
+// texture is specified from the buffer in one call, so the placeholder stays
+// until the image is complete.
+class TextureStreamer {
+public:
+	typedef std::function<void()> Callback;
+
+	struct Source;  // decoded pixels, defined in TextureStreamer.cpp
+
+private:
+	struct Item;
+
+	ThreadPool & pool;
+	std::mutex mutex;
+	std::condition_variable decoded;
+	std::vector<std::shared_ptr<Item>> items;   // request order
+	int decoding;
+
+	std::chrono::steady_clock::time_point created;
+
+	std::shared_ptr<Item> newItem(GLuint texture, GLenum target, GLenum internalFormat, const char * path, Callback onResident, int layers);
+	void placeholder(const Item & item, const unsigned char * rgba);
+	void decode(std::shared_ptr<Item> item, const std::vector<std::function<Source *()>> & loads);
+
+public:
+	TextureStreamer(ThreadPool & pool);
+	TextureStreamer();
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer &) = delete;
+	TextureStreamer & operator=(const TextureStreamer &) = delete;
+
+	// Streams an image (see Image.h) into the GL_TEXTURE_2D texture. onResident
+	// runs on the GL thread inside update() once the texture holds the image.
+	void requestImage(GLuint texture, const char * path, GLenum internalFormat, const unsigned char placeholderRgba[4], Callback onResident = Callback());
+
+	// Streams images of the same size into the layers of a GL_TEXTURE_2D_ARRAY,
+	// decoding them in parallel. The array is specified once every layer is in,
+	// layers that fail to load stay black. RGB and BGR files can be mixed.
+	void requestImageArray(GLuint texture, const std::vector<std::string> & paths, GLenum internalFormat, const unsigned char placeholderRgba[4],
+		Callback onResident = Callback());
+
+	// Streams a table file (see Tables.h), converting the raw file first if needed
+	void requestTable(GLuint texture, const char * tablePath, const char * rawPath, unsigned int width, unsigned int height, unsigned int channels,
+		const unsigned char placeholderRgba[4], Callback onResident = Callback());
+
+	// Drops pending requests for a texture that is about to be filled another way
+	void cancel(GLuint texture);
+
+	// Call once per frame on the GL thread
+	void update(size_t byteBudget = TEXTURE_STREAM_BUDGET);
+
+	// Blocks until every request is resident or failed, for runs that must not
+	// see placeholders
+	void finish();
+
+	int pending();
+};
+
+#endif __TEXTURE_STREAMER_H__
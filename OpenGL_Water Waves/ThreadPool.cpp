@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads) : busy{ 0 }, stopping{ false } {
+	if (threads == 0) {
+		unsigned int hw = std::thread::hardware_concurrency();
+		threads = hw > 1 ? hw - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	available.notify_all();
+	for (std::thread & worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop() {
+#ifdef OCEAN_TRACE
+	Trace::setThreadName("pool worker");
+#endif
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			available.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty()) {
+				return; // stopping and drained
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			busy++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy--;
+			if (busy == 0 && tasks.empty()) {
+				idle.notify_all();
+			}
+		}
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	available.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return busy == 0 && tasks.empty(); });
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> & body) {
+	if (end <= begin) {
+		return;
+	}
+	grain = std::max(grain, 1);
+	int chunks = (end - begin + grain - 1) / grain;
+	if (chunks == 1 || workers.empty()) {
+		body(begin, end);
+		return;
+	}
+
+	// Shared with the helper tasks, which may start after this call has returned
+	struct Job {
+		std::atomic<int> next;
+		std::atomic<int> done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->next = 0;
+	job->done = 0;
+
+	// body lives on the caller's stack, helpers only touch it while chunks remain
+	const std::function<void(int, int)> * work = &body;
+	auto run = [job, work, begin, end, grain, chunks]() {
+		int chunk;
+		while ((chunk = job->next.fetch_add(1)) < chunks) {
+			int b = begin + chunk * grain;
+			TRACE_SCOPE("parallelFor chunk");
+			(*work)(b, std::min(b + grain, end));
+			if (job->done.fetch_add(1) + 1 == chunks) {
+				std::lock_guard<std::mutex> lock(job->mutex);
+				job->finished.notify_all();
+			}
+		}
+	};
+
+	int helpers = std::min(chunks - 1, (int)workers.size());
+	for (int i = 0; i < helpers; i++) {
+		submit(run);
+	}
+	run();
+
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->finished.wait(lock, [&job, chunks] { return job->done.load() == chunks; });
+}
+
+ThreadPool & ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
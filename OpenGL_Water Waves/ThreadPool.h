@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+
+	std::mutex mutex;
+	std::condition_variable available;
+	std::condition_variable idle;
+
+	unsigned int busy;
+	bool stopping;
+
+	void workerLoop();
+
+public:
+	// 0 threads means one per hardware thread, minus the caller
+	ThreadPool(unsigned int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	unsigned int size() const { return (unsigned int)workers.size(); }
+
+	void submit(std::function<void()> task);
+
+	// Blocks until every submitted task has finished
+	void wait();
+
+	// Splits [begin, end) in chunks of grain items and runs body(chunkBegin, chunkEnd)
+	// on the workers. The calling thread takes chunks too, so it is safe to call from a task.
+	void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> & body);
+
+	// Process wide pool shared by the loaders and precomputations
+	static ThreadPool & shared();
+};
+
+#endif __THREAD_POOL_H__
@@ -0,0 +1,145 @@
+#include "stdafx.h"
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Events per thread, recording stops silently once a buffer is full
+#define TRACE_BUFFER_EVENTS (1 << 16)
+
+namespace {
+
+	struct Event {
+		const char * name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	struct ThreadBuffer {
+		Event * events;
+		std::atomic<uint32_t> count;
+		uint32_t tid;
+		std::string name;
+	};
+
+	std::mutex registryMutex; // only taken when a thread records its first event
+	std::vector<ThreadBuffer *> buffers;
+
+	std::atomic<bool> active(false);
+	std::atomic<long> frame(0);
+	long firstFrame = 0;
+	long lastFrame = -1;
+	std::string outputPath;
+	std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+	// frame boundaries, written by the thread calling nextFrame()
+	std::vector<std::pair<long, uint64_t>> frameMarks;
+
+	thread_local ThreadBuffer * local = NULL;
+
+	ThreadBuffer * threadBuffer() {
+		if (local == NULL) {
+			ThreadBuffer * buffer = new ThreadBuffer;
+			buffer->events = new Event[TRACE_BUFFER_EVENTS];
+			buffer->count = 0;
+			std::lock_guard<std::mutex> lock(registryMutex);
+			buffer->tid = (uint32_t)buffers.size() + 1;
+			buffers.push_back(buffer);
+			local = buffer;
+		}
+		return local;
+	}
+
+	void writeEscaped(FILE * file, const char * s) {
+		for (; *s; s++) {
+			if (*s == '"' || *s == '\\') fputc('\\', file);
+			fputc(*s, file);
+		}
+	}
+}
+
+uint64_t Trace::now() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void Trace::start(const char * path, long first, long last) {
+	outputPath = path;
+	firstFrame = first;
+	lastFrame = last;
+	frameMarks.clear();
+	active = true;
+	setThreadName("main");
+}
+
+bool Trace::recording() {
+	if (!active.load(std::memory_order_relaxed)) return false;
+	long f = frame.load(std::memory_order_relaxed);
+	return f >= firstFrame && f <= lastFrame;
+}
+
+void Trace::record(const char * name, uint64_t begin, uint64_t end) {
+	ThreadBuffer * buffer = threadBuffer();
+	uint32_t n = buffer->count.load(std::memory_order_relaxed);
+	if (n >= TRACE_BUFFER_EVENTS) return;
+	buffer->events[n].name = name;
+	buffer->events[n].begin = begin;
+	buffer->events[n].end = end;
+	buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void Trace::nextFrame() {
+	long f = frame.fetch_add(1) + 1;
+	if (!active) return;
+
+	if (f >= firstFrame && f <= lastFrame) {
+		frameMarks.push_back(std::make_pair(f, now()));
+	}
+	if (f > lastFrame) {
+		flush();
+	}
+}
+
+void Trace::setThreadName(const char * name) {
+	threadBuffer()->name = name;
+}
+
+void Trace::flush() {
+	if (!active.exchange(false)) return;
+
+	FILE * file = fopen(outputPath.c_str(), "w");
+	if (file == NULL) {
+		printf("Trace %s could not be written\n", outputPath.c_str());
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	size_t total = 0;
+	for (ThreadBuffer * buffer : buffers) {
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",\n", buffer->tid);
+		writeEscaped(file, buffer->name.empty() ? "worker" : buffer->name.c_str());
+		fprintf(file, "\"}}");
+		first = false;
+
+		uint32_t n = buffer->count.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < n; i++) {
+			const Event & e = buffer->events[i];
+			fprintf(file, ",\n{\"name\":\"");
+			writeEscaped(file, e.name);
+			fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->tid, e.begin / 1000.0, (e.end - e.begin) / 1000.0);
+		}
+		total += n;
+	}
+	for (const std::pair<long, uint64_t> & mark : frameMarks) {
+		fprintf(file, ",\n{\"name\":\"frame %ld\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":1,\"ts\":%.3f}", mark.first, mark.second / 1000.0);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("Trace of frames %ld-%ld written to %s (%zu events)\n", firstFrame, lastFrame, outputPath.c_str(), total);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <cstdint>
+
+// Scoped CPU timers exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Build with OCEAN_TRACE defined to enable them, otherwise TRACE_SCOPE and
+// TRACE_FRAME expand to nothing. Each thread records into its own buffer, so
+// recording an event takes no lock.
+//
+//   Trace::start("trace.json", 0, 10);  // frame 0 is startup, before the first display()
+//   ...
+//   TRACE_SCOPE("generateMesh");
+//   ...
+//   TRACE_FRAME();                       // after each frame, writes the file past the last one
+
+namespace Trace {
+
+	uint64_t now(); // ns since the trace started
+
+	void start(const char * path, long firstFrame, long lastFrame);
+	void nextFrame();
+	bool recording();
+
+	void record(const char * name, uint64_t begin, uint64_t end);
+
+	// Writes the events gathered so far and stops recording
+	void flush();
+
+	// Name shown for the calling thread in the viewer
+	void setThreadName(const char * name);
+}
+
+class TraceScope {
+private:
+	const char * name;
+	bool active;
+	uint64_t begin;
+public:
+	TraceScope(const char * n) : name{ n }, active{ Trace::recording() }, begin{ active ? Trace::now() : 0 } {}
+	~TraceScope() { if (active) Trace::record(name, begin, Trace::now()); }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef OCEAN_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_FRAME() Trace::nextFrame()
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_FRAME()
+#endif
+
+#endif __TRACE_H__
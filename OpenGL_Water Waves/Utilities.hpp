@@ -16,6 +16,10 @@
 #include <GL/glew.h>
 #include <vector>
 #include <map>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -24,6 +28,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include "MappedFile.h"
+#include "Tables.h"
+#include "ThreadPool.h"
 
 
 GLenum glCheckError_(const char *file, int line)
@@ -96,107 +103,503 @@ std::vector<float> skyboxVertices = {
 
 
 struct CharacterU {
-	GLuint     TextureID;  // ID handle of the glyph texture
+	glm::vec2  UvMin;      // corners of the glyph in the atlas
+	glm::vec2  UvMax;
 	glm::ivec2 Size;       // Size of glyph
 	glm::ivec2 Bearing;    // Offset from baseline to left/top of glyph
 	GLuint     Advance;    // Offset to advance to next glyph
 };
 
 
-class FontLoader {
-private:
-	static std::map<char, CharacterU> Characters;
+// Side of the square GL_RED glyph atlas of each font, 256 KB
+#define GLYPH_ATLAS_SIZE 512
 
-	char* name;
-	int size;
+// Next codepoint of UTF-8 text, U+FFFD for malformed sequences
+uint32_t decodeUtf8(const std::string & text, size_t & i) {
+	unsigned char c = (unsigned char)text[i++];
+	int extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xE ? 2 : (c >> 3) == 0x1E ? 3 : -1;
+	if (extra < 0) return 0xFFFD;
 
-	FT_Face* font;
+	uint32_t codepoint = extra == 0 ? c : c & (0x3F >> extra);
+	for (int k = 0; k < extra; k++) {
+		if (i >= text.size() || ((unsigned char)text[i] & 0xC0) != 0x80) return 0xFFFD;
+		codepoint = (codepoint << 6) | ((unsigned char)text[i++] & 0x3F);
+	}
 
-public:
-	FontLoader() {};
-	FontLoader(const char* path, int size);
+	// overlong forms, surrogates and values past U+10FFFF are not characters
+	static const uint32_t smallest[4] = { 0, 0x80, 0x800, 0x10000 };
+	if (codepoint < smallest[extra] || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF) return 0xFFFD;
+	return codepoint;
+}
 
-	std::map<char, CharacterU>* getCharMap() { return &Characters; }
-	
+// Distance field glyphs are rendered once at SDF_GLYPH_SIZE pixels and scaled
+// for every size, the field reaches SDF_SPREAD pixels either side of the outline
+#define SDF_GLYPH_SIZE 32
+#define SDF_SPREAD 4
+
+enum FontMode { FONT_BITMAP, FONT_SDF };
+
+// Glyph pixels on their way into an atlas cell: coverage, or distances once
+// distanceField() has run
+struct GlyphBitmap {
+	uint32_t codepoint;
+	int width, height;
+	int left, top;      // bearing
+	GLuint advance;     // 1/64 pixels
+	std::vector<unsigned char> pixels;
 };
 
-std::map<char, CharacterU> FontLoader::Characters;
+// Squared distance transform of one row or column (Felzenszwalb and
+// Huttenlocher), f and d hold n values, v and z are scratch for n and n + 1
+void distanceTransform1D(const float * f, int n, float * d, int * v, float * z) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+	for (int q = 1; q < n; q++) {
+		float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = 1e20f;
+	}
+	k = 0;
+	for (int q = 0; q < n; q++) {
+		while (z[k + 1] < q) k++;
+		d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+	}
+}
+
+// Squared distance of every texel to the nearest texel where target is set
+void distanceTransform2D(const std::vector<bool> & target, int w, int h, std::vector<float> & out) {
+	int n = std::max(w, h);
+	std::vector<float> f(n), d(n), z(n + 1);
+	std::vector<int> v(n);
+	out.resize((size_t)w * h);
+	for (size_t i = 0; i < out.size(); i++) out[i] = target[i] ? 0.0f : 1e20f;
+
+	for (int x = 0; x < w; x++) {
+		for (int y = 0; y < h; y++) f[y] = out[(size_t)y * w + x];
+		distanceTransform1D(f.data(), h, d.data(), v.data(), z.data());
+		for (int y = 0; y < h; y++) out[(size_t)y * w + x] = d[y];
+	}
+	for (int y = 0; y < h; y++) {
+		distanceTransform1D(&out[(size_t)y * w], w, d.data(), v.data(), z.data());
+		memcpy(&out[(size_t)y * w], d.data(), w * sizeof(float));
+	}
+}
+
+// Replaces the coverage of a glyph with its signed distance field, padded by
+// SDF_SPREAD on every side. 128 is the outline, inside is brighter.
+void distanceField(GlyphBitmap & glyph) {
+	int w = glyph.width + 2 * SDF_SPREAD, h = glyph.height + 2 * SDF_SPREAD;
+	std::vector<bool> inside((size_t)w * h, false), outside((size_t)w * h, true);
+	for (int y = 0; y < glyph.height; y++) {
+		for (int x = 0; x < glyph.width; x++) {
+			bool in = glyph.pixels[(size_t)y * glyph.width + x] >= 128;
+			inside[(size_t)(y + SDF_SPREAD) * w + x + SDF_SPREAD] = in;
+			outside[(size_t)(y + SDF_SPREAD) * w + x + SDF_SPREAD] = !in;
+		}
+	}
+
+	std::vector<float> toInside, toOutside;
+	distanceTransform2D(inside, w, h, toInside);
+	distanceTransform2D(outside, w, h, toOutside);
+
+	std::vector<unsigned char> field((size_t)w * h);
+	for (size_t i = 0; i < field.size(); i++) {
+		// texel centres are half a texel off the outline
+		float d = inside[i] ? sqrtf(toOutside[i]) - 0.5f : 0.5f - sqrtf(toInside[i]);
+		field[i] = (unsigned char)std::min(std::max(128.0f + d * 127.0f / SDF_SPREAD, 0.0f), 255.0f);
+	}
+
+	glyph.pixels.swap(field);
+	glyph.width = w;
+	glyph.height = h;
+	glyph.left -= SDF_SPREAD;
+	glyph.top += SDF_SPREAD;
+}
+
+// Distance field glyphs cached next to the font:
+//   SdfHeader | SdfGlyphRecord[glyphCount] | pixels
+#define SDF_MAGIC "OSDF"
+#define SDF_VERSION 1
+
+struct SdfHeader {
+	char     magic[4];
+	uint16_t version;
+	uint16_t glyphSize;    // SDF_GLYPH_SIZE
+	uint16_t spread;       // SDF_SPREAD
+	uint16_t reserved;
+	uint32_t glyphCount;
+	uint32_t fontSize;     // bytes of the font file, with its checksum
+	uint32_t fontChecksum; // tell a stale cache apart
+	uint32_t payloadSize;  // records and pixels
+	uint32_t checksum;     // FNV-1a of the payload
+};
+
+struct SdfGlyphRecord {
+	uint32_t codepoint;
+	uint16_t width, height;
+	int16_t  left, top;
+	uint32_t advance;
+	uint32_t offset;       // of the pixels, from the end of the records
+};
+
+bool readDistanceFields(const char * path, const MappedFile & font, std::vector<GlyphBitmap> & glyphs) {
+	MappedFile file(path);
+	if (!file.isOpen() || file.size() < sizeof(SdfHeader)) return false;
+
+	SdfHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, SDF_MAGIC, 4) != 0 || header.version != SDF_VERSION || header.glyphSize != SDF_GLYPH_SIZE || header.spread != SDF_SPREAD ||
+		header.fontSize != (uint32_t)font.size() || header.fontChecksum != tableChecksum(font.data(), font.size()) ||
+		header.payloadSize != file.size() - sizeof(SdfHeader) || (size_t)header.glyphCount * sizeof(SdfGlyphRecord) > header.payloadSize ||
+		header.checksum != tableChecksum(file.data() + sizeof(SdfHeader), header.payloadSize)) {
+		printf("Glyph cache %s is stale, rebuilding it\n", path);
+		return false;
+	}
+
+	const unsigned char * records = file.data() + sizeof(SdfHeader);
+	const unsigned char * pixels = records + header.glyphCount * sizeof(SdfGlyphRecord);
+	size_t pixelBytes = header.payloadSize - header.glyphCount * sizeof(SdfGlyphRecord);
+	for (uint32_t i = 0; i < header.glyphCount; i++) {
+		SdfGlyphRecord record;
+		memcpy(&record, records + i * sizeof(SdfGlyphRecord), sizeof(record));
+		size_t size = (size_t)record.width * record.height;
+		if (record.offset > pixelBytes || pixelBytes - record.offset < size) return false;
+
+		GlyphBitmap glyph;
+		glyph.codepoint = record.codepoint;
+		glyph.width = record.width;
+		glyph.height = record.height;
+		glyph.left = record.left;
+		glyph.top = record.top;
+		glyph.advance = record.advance;
+		glyph.pixels.assign(pixels + record.offset, pixels + record.offset + size);
+		glyphs.push_back(glyph);
+	}
+	return true;
+}
+
+bool writeDistanceFields(const char * path, const MappedFile & font, const std::vector<GlyphBitmap> & glyphs) {
+	std::vector<unsigned char> payload(glyphs.size() * sizeof(SdfGlyphRecord));
+	for (size_t i = 0; i < glyphs.size(); i++) {
+		const GlyphBitmap & glyph = glyphs[i];
+		SdfGlyphRecord record;
+		record.codepoint = glyph.codepoint;
+		record.width = (uint16_t)glyph.width;
+		record.height = (uint16_t)glyph.height;
+		record.left = (int16_t)glyph.left;
+		record.top = (int16_t)glyph.top;
+		record.advance = glyph.advance;
+		record.offset = (uint32_t)(payload.size() - glyphs.size() * sizeof(SdfGlyphRecord));
+		memcpy(&payload[i * sizeof(SdfGlyphRecord)], &record, sizeof(record));
+		payload.insert(payload.end(), glyph.pixels.begin(), glyph.pixels.end());
+	}
 
-FontLoader::FontLoader(const char * path, int size) {
+	SdfHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SDF_MAGIC, 4);
+	header.version = SDF_VERSION;
+	header.glyphSize = SDF_GLYPH_SIZE;
+	header.spread = SDF_SPREAD;
+	header.glyphCount = (uint32_t)glyphs.size();
+	header.fontSize = (uint32_t)font.size();
+	header.fontChecksum = tableChecksum(font.data(), font.size());
+	header.payloadSize = (uint32_t)payload.size();
+	header.checksum = tableChecksum(payload.data(), payload.size());
+
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Glyph cache %s could not be opened\n", path);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(payload.data(), payload.size(), 1, file) == 1;
+	ok = (fclose(file) == 0) && ok;
+	if (!ok) {
+		printf("Glyph cache %s could not be written\n", path);
+		remove(path);
+	}
+	return ok;
+}
+
+// One face at one pixel size. Glyphs are rasterized the first time they are
+// asked for, into fixed cells of a single atlas; when every cell is taken the
+// least recently used glyph gives its cell up.
+//
+// In FONT_SDF mode the atlas holds distance fields rendered at SDF_GLYPH_SIZE,
+// drawn with text_sdf.fs.glsl they stay sharp at any scale, so one FontLoader
+// serves every size. Printable ASCII is built in parallel at load and cached
+// in <font>.sdf, other glyphs follow on first use.
+class FontLoader {
+private:
+	struct Cell {
+		uint32_t codepoint;
+		CharacterU character;
+		unsigned generation;               // layout that last used it
+		std::list<int>::iterator lru;
+	};
 
 	FT_Library ft;
-	if (FT_Init_FreeType(&ft))
+	FT_Face face;
+	MappedFile fontFile; // FreeType reads the face from it for as long as it lives
+	FontMode mode;
+
+	GLuint atlas;
+	int atlasSize;
+	int cellWidth, cellHeight, columns, capacity;
+	int lineHeight;     // baseline to baseline, in atlas pixels
+	float metricScale;  // atlas pixels to pixels of the requested size
+	int size;
+
+	std::vector<Cell> cells;
+	std::list<int> lru;                      // most recent first
+	std::unordered_map<uint32_t, int> cache; // codepoint to cell, -1 when the face has no glyph
+	std::vector<unsigned char> scratch;      // one cell of pixels
+	unsigned generation;
+	unsigned evictions;
+
+	bool render(uint32_t codepoint, GlyphBitmap & glyph);
+	int store(const GlyphBitmap & glyph);
+	int rasterize(uint32_t codepoint);
+	void preloadDistanceFields(const char * path);
+
+public:
+	FontLoader(const char* path, int size, FontMode mode = FONT_BITMAP, int atlasSize = GLYPH_ATLAS_SIZE);
+	~FontLoader();
+
+	FontLoader(const FontLoader &) = delete;
+	FontLoader & operator=(const FontLoader &) = delete;
+
+	// NULL when the face has no glyph, or when every cell holds a glyph of the
+	// current layout
+	const CharacterU * glyph(uint32_t codepoint);
+
+	// Glyphs used from here on stay in the atlas until the next call
+	void beginLayout() { generation++; }
+	// Changes whenever a cell is reused, cached layouts are stale then
+	unsigned getEvictions() const { return evictions; }
+
+	FontMode getMode() const { return mode; }
+	GLuint getAtlas() const { return atlas; }
+	int getLineHeight() const { return lineHeight; }
+	// Glyph metrics are in atlas pixels, multiply by this for the requested size
+	float getMetricScale() const { return metricScale; }
+	int residentGlyphs() const { return (int)cells.size(); }
+};
+
+FontLoader::FontLoader(const char * path, int size, FontMode mode, int atlasSize) {
+	this->size = size;
+	this->mode = mode;
+	this->ft = NULL;
+	this->face = NULL;
+	this->atlas = 0;
+	this->atlasSize = atlasSize;
+	this->lineHeight = size;
+	this->metricScale = 1.0f;
+	this->cellWidth = this->cellHeight = size;
+	this->columns = this->capacity = 0;
+	this->generation = 0;
+	this->evictions = 0;
+
+	if (FT_Init_FreeType(&ft)) {
 		std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+		ft = NULL;
+		return;
+	}
 
-	FT_Face face;
-	if (FT_New_Face(ft, path, 0, &face))
+	// through MappedFile so the font can come from the asset pack
+	if (!fontFile.open(path) || FT_New_Memory_Face(ft, fontFile.data(), (FT_Long)fontFile.size(), 0, &face)) {
 		std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+		face = NULL;
+		return;
+	}
 
-	this->font = &face;
+	int pixels = mode == FONT_SDF ? SDF_GLYPH_SIZE : size;
+	int padding = mode == FONT_SDF ? 2 * SDF_SPREAD : 0;
+	FT_Set_Pixel_Sizes(face, 0, pixels);
+	lineHeight = (int)(face->size->metrics.height >> 6);
+	metricScale = (float)size / pixels;
+
+	// cells fit the widest advance and the full ascender to descender height,
+	// plus a texel so linear filtering does not pick up a neighbour
+	cellWidth = (int)(face->size->metrics.max_advance >> 6) + padding + 1;
+	cellHeight = (int)((face->size->metrics.ascender - face->size->metrics.descender) >> 6) + padding + 1;
+	columns = atlasSize / cellWidth;
+	capacity = columns * (atlasSize / cellHeight);
+	scratch.resize((size_t)cellWidth * cellHeight);
+
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasSize, atlasSize, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	if (mode == FONT_SDF) {
+		preloadDistanceFields((std::string(path) + ".sdf").c_str());
+	}
+}
 
-	FT_Set_Pixel_Sizes(face, 0, size);
+FontLoader::~FontLoader() {
+	glDeleteTextures(1, &atlas);
+	if (face != NULL) FT_Done_Face(face);
+	if (ft != NULL) FT_Done_FreeType(ft);
+}
 
-	this->size = size;
+void FontLoader::preloadDistanceFields(const char * path) {
+	std::vector<GlyphBitmap> glyphs;
+	if (!readDistanceFields(path, fontFile, glyphs)) {
+		glyphs.clear();
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
+		// FreeType is not thread safe, it rasterizes here and the distance
+		// transforms, most of the work, run on the pool
+		for (uint32_t c = 32; c < 127; c++) {
+			GlyphBitmap glyph;
+			if (render(c, glyph)) glyphs.push_back(glyph);
+		}
+		ThreadPool::shared().parallelFor(0, (int)glyphs.size(), 4, [&glyphs](int begin, int end) {
+			for (int i = begin; i < end; i++) distanceField(glyphs[i]);
+		});
+		writeDistanceFields(path, fontFile, glyphs);
+	}
 
-	for (GLubyte c = 0; c < 128; c++)
-	{
-		// Load character glyph 
-		if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-		{
-			std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-			continue;
+	for (const GlyphBitmap & glyph : glyphs) {
+		if (store(glyph) < 0) break;
+	}
+}
+
+// Coverage of a glyph, false when the face has none
+bool FontLoader::render(uint32_t codepoint, GlyphBitmap & glyph) {
+	// Load character glyph 
+	FT_UInt index = FT_Get_Char_Index(face, codepoint);
+	if (index == 0 || FT_Load_Glyph(face, index, FT_LOAD_RENDER)) {
+		return false;
+	}
+
+	const FT_Bitmap & bitmap = face->glyph->bitmap;
+	glyph.codepoint = codepoint;
+	glyph.width = (int)bitmap.width;
+	glyph.height = (int)bitmap.rows;
+	glyph.left = face->glyph->bitmap_left;
+	glyph.top = face->glyph->bitmap_top;
+	glyph.advance = (GLuint)face->glyph->advance.x;
+	glyph.pixels.resize((size_t)glyph.width * glyph.height);
+	for (int row = 0; row < glyph.height; row++) {
+		memcpy(&glyph.pixels[(size_t)row * glyph.width], bitmap.buffer + row * bitmap.pitch, glyph.width);
+	}
+	return true;
+}
+
+// Uploads a glyph into a free or the least recently used cell
+int FontLoader::store(const GlyphBitmap & glyph) {
+	int cell;
+	if ((int)cells.size() < capacity) {
+		cell = (int)cells.size();
+		cells.push_back(Cell());
+		lru.push_front(cell);
+		cells[cell].lru = lru.begin();
+	}
+	else {
+		// glyphs of the layout in progress keep their cells, its quads point at them
+		cell = lru.back();
+		if (cells[cell].generation == generation) {
+			return -1;
 		}
-		// Generate texture
-		GLuint texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RED,
-			face->glyph->bitmap.width,
-			face->glyph->bitmap.rows,
-			0,
-			GL_RED,
-			GL_UNSIGNED_BYTE,
-			face->glyph->bitmap.buffer
-		);
-		// Set texture options
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// Now store character for later use
-		CharacterU character = {
-			texture,
-			glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-			face->glyph->advance.x
-		};
-		Characters.insert(std::pair<char, CharacterU>(c, character));
+		cache.erase(cells[cell].codepoint);
+		evictions++;
+	}
+
+	// glyphs larger than a cell are clipped, the cell is uploaded whole so
+	// nothing of the previous glyph remains
+	int w = std::min(glyph.width, cellWidth - 1), h = std::min(glyph.height, cellHeight - 1);
+	std::fill(scratch.begin(), scratch.end(), 0);
+	for (int row = 0; row < h; row++) {
+		memcpy(&scratch[(size_t)row * cellWidth], &glyph.pixels[(size_t)row * glyph.width], w);
 	}
 
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
+	int x = (cell % columns) * cellWidth, y = (cell / columns) * cellHeight;
+	GLint alignment, bound;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cellWidth, cellHeight, GL_RED, GL_UNSIGNED_BYTE, scratch.data());
+	glBindTexture(GL_TEXTURE_2D, bound);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	Cell & c = cells[cell];
+	c.codepoint = glyph.codepoint;
+	c.generation = generation;
+	c.character.UvMin = glm::vec2((float)x / atlasSize, (float)y / atlasSize);
+	c.character.UvMax = glm::vec2((float)(x + w) / atlasSize, (float)(y + h) / atlasSize);
+	c.character.Size = glm::ivec2(w, h);
+	c.character.Bearing = glm::ivec2(glyph.left, glyph.top);
+	c.character.Advance = glyph.advance;
+	cache[glyph.codepoint] = cell;
+	return cell;
+}
+
+const CharacterU * FontLoader::glyph(uint32_t codepoint) {
+	std::unordered_map<uint32_t, int>::iterator it = cache.find(codepoint);
+	int cell = it != cache.end() ? it->second : rasterize(codepoint);
+	if (cell < 0) return NULL;
 
+	Cell & c = cells[cell];
+	c.generation = generation;
+	lru.splice(lru.begin(), lru, c.lru);
+	return &c.character;
 }
 
+int FontLoader::rasterize(uint32_t codepoint) {
+	if (face == NULL || capacity == 0) return -1;
+
+	GlyphBitmap glyph;
+	if (!render(codepoint, glyph)) {
+		cache[codepoint] = -1;
+		return -1;
+	}
+	if (mode == FONT_SDF) {
+		distanceField(glyph);
+	}
+	return store(glyph);
+}
+
+// UTF-8 text laid out into one vertex buffer and drawn with one call. The layout
+// is kept until the string, its position or the font atlas changes, '\n' starts
+// a new line.
 class Text {
 	std::string text;
 	FontLoader * font;
 	GLuint VAO, VBO, IBO;
 	GLuint shader;
 
-
 	glm::mat4 projection;
+
+	// Layout of the last call: 4 vertices of (x, y, u, v) per glyph
+	std::vector<GLfloat> quads;
+	int glyphs;
+	int capacity;       // glyphs the buffers hold
+	bool dirty;         // quads no longer match the buffer
+	unsigned atlasVersion; // font evictions when laid out
+	glm::vec3 placed;   // x, y and scale of the layout
 public:
-	Text() {};
+	Text() : font(NULL), VAO(0), VBO(0), IBO(0), glyphs(0), capacity(0), dirty(true), atlasVersion(0) {};
 	Text(std::string, FontLoader *);
-	
+	~Text();
+
+	Text(const Text &) = delete;
+	Text & operator=(const Text &) = delete;
 
-	void setText(std::string t) { this->text = t; }
+	void setText(const std::string & t) { if (t != text) { text = t; dirty = true; } }
+	// CPU side of RenderText, fills quads and returns the number of glyphs
+	int layout(GLfloat x, GLfloat y, GLfloat scale);
 	void RenderText(GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color);
 	void setShader(GLuint & s) { this->shader = s; }
 };
@@ -204,27 +607,110 @@ public:
 Text::Text(std::string t, FontLoader * f) {
 	this->text = t;
 	this->font = f;
+	this->glyphs = 0;
+	this->capacity = 0;
+	this->dirty = true;
+	this->atlasVersion = 0;
 
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &IBO);
 
 	glBindVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	int x, y;
+	// pixels of the current viewport, which is not always a window
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
 
-	glfwGetWindowSize(glfwGetCurrentContext(), &x, &y);
+	projection = glm::ortho(0.0f, (float) viewport[2], 0.0f, (float) viewport[3]);
+}
 
-	projection = glm::ortho(0.0f, (float) x, 0.0f, (float) y);
+Text::~Text() {
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &IBO);
+	glDeleteVertexArrays(1, &VAO);
+}
+
+int Text::layout(GLfloat x, GLfloat y, GLfloat scale) {
+	quads.clear();
+	glyphs = 0;
+	placed = glm::vec3(x, y, scale);
+	dirty = true;
+
+	font->beginLayout();
+
+	// distance field glyphs are stored at one size and scaled to the requested one
+	scale *= font->getMetricScale();
+	GLfloat left = x;
+	for (size_t i = 0; i < text.size();)
+	{
+		uint32_t c = decodeUtf8(text, i);
+		if (c == '\n') {
+			x = left;
+			y -= font->getLineHeight() * scale;
+			continue;
+		}
+		const CharacterU * ch = font->glyph(c);
+		if (ch == NULL) continue; // not in the face
+
+		GLfloat xpos = x + ch->Bearing.x * scale;
+		GLfloat ypos = y - (ch->Size.y - ch->Bearing.y) * scale;
+
+		GLfloat w = ch->Size.x * scale;
+		GLfloat h = ch->Size.y * scale;
+
+		// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
+		x += (ch->Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
+		if (w == 0.0f || h == 0.0f) continue; // spaces only advance
+
+		GLfloat vertices[4][4] = {
+		{ xpos,     ypos + h,   ch->UvMin.x, ch->UvMin.y },
+		{ xpos,     ypos,       ch->UvMin.x, ch->UvMax.y },
+		{ xpos + w, ypos,       ch->UvMax.x, ch->UvMax.y },
+		{ xpos + w, ypos + h,   ch->UvMax.x, ch->UvMin.y }
+		};
+		quads.insert(quads.end(), &vertices[0][0], &vertices[0][0] + 4 * 4);
+		glyphs++;
+	}
+	// after the loop, evictions made by this layout do not invalidate it
+	atlasVersion = font->getEvictions();
+	return glyphs;
 }
 
 void Text::RenderText(GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
-	
+
+	if (dirty || placed != glm::vec3(x, y, scale) || atlasVersion != font->getEvictions()) {
+		layout(x, y, scale);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (glyphs > capacity) {
+			// grow both buffers to the next power of two, the indices never change
+			capacity = std::max(capacity, 64);
+			while (capacity < glyphs) capacity *= 2;
+			std::vector<GLuint> indices;
+			indices.reserve(capacity * 6);
+			for (GLuint g = 0; g < (GLuint)capacity; g++) {
+				GLuint quad[6] = { g * 4, g * 4 + 1, g * 4 + 2, g * 4, g * 4 + 2, g * 4 + 3 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, capacity * 4 * 4 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+		}
+		if (glyphs > 0) {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, quads.size() * sizeof(GLfloat), quads.data());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		dirty = false;
+	}
+	if (glyphs == 0) return;
+
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -234,48 +720,11 @@ void Text::RenderText(GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
 
 	glUniform3f(glGetUniformLocation(shader, "textColor"), color.x, color.y, color.z);
 	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, font->getAtlas());
 	glBindVertexArray(VAO);
 
-	std::map<char, CharacterU>* Characters = font->getCharMap();
-	std::map<char, CharacterU>::iterator it;
-
-	// Iterate through all characters
-	std::string::const_iterator c;
-	for (c = text.begin(); c != text.end(); c++)
-	{
-
-		it = Characters->find(*c);
-		CharacterU ch = it->second; 
-
-		GLfloat xpos = x + ch.Bearing.x * scale;
-		GLfloat ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
-
-		GLfloat w = ch.Size.x * scale;
-		GLfloat h = ch.Size.y * scale;
-		// Update VBO for each character
-		GLfloat vertices[6][4] = {
-		{ xpos,     ypos + h,   0.0, 0.0 },
-		{ xpos,     ypos,       0.0, 1.0 },
-		{ xpos + w, ypos,       1.0, 1.0 },
-
-		{ xpos,     ypos + h,   0.0, 0.0 },
-		{ xpos + w, ypos,       1.0, 1.0 },
-		{ xpos + w, ypos + h,   1.0, 0.0 }
-		};
-		
-		
+	glDrawElements(GL_TRIANGLES, glyphs * 6, GL_UNSIGNED_INT, (void*)0);
 
-		// Render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-		// Update content of VBO memory
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		// Render quad
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-		x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
-	}
 	glBindVertexArray(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -377,6 +826,7 @@ void indexVBO_slow(
 			out_indices.push_back((unsigned short)out_vertices.size() - 1);
 		}
 	}
+	if (out_vertices.size() > 65536) printf("indexVBO_slow: %u vertices overflow 16 bit indices, use indexVBO of VertexIndex.h\n", (unsigned int)out_vertices.size());
 }
 
 void indexVBO(
@@ -413,10 +863,12 @@ void indexVBO(
 			VertexToOutIndex[packed] = newindex;
 		}
 	}
+	if (out_vertices.size() > 65536) printf("indexVBO: %u vertices overflow 16 bit indices, use indexVBO of VertexIndex.h\n", (unsigned int)out_vertices.size());
 }
 
 
 //Load Images (BMP) and models (OBJ)
+// Kept as the benchmark reference, Image.h and ObjLoader.h replace them
 
 LoadedTexture* loadBMP_custom(const char * imagepath) {
 	// Data read from the header of the BMP file
@@ -428,18 +880,19 @@ LoadedTexture* loadBMP_custom(const char * imagepath) {
 	unsigned char * data;
 
 	// Open the file
-	FILE * file;
-	errno_t err;
-	if ((err = fopen_s(&file, imagepath, "rb")) != 0) { printf("Image could not be opened\n"); return 0; }
+	FILE * file = fopen(imagepath, "rb");
+	if (file == NULL) { printf("Image could not be opened\n"); return NULL; }
 
-	if (fread_s(header, sizeof(header), 1, 54, file) != 54) { // If not 54 bytes read : problem
+	if (fread(header, 1, sizeof(header), file) != 54) { // If not 54 bytes read : problem
 		printf("Not a correct BMP file\n");
-		return false;
+		fclose(file);
+		return NULL;
 	}
 
 	if (header[0] != 'B' || header[1] != 'M') {
 		printf("Not a correct BMP file\n");
-		return 0;
+		fclose(file);
+		return NULL;
 	}
 
 	// Read ints from the byte array
@@ -456,7 +909,7 @@ LoadedTexture* loadBMP_custom(const char * imagepath) {
 	data = new unsigned char[imageSize];
 
 	// Read the actual data from the file into the buffer
-	fread_s(data, imageSize * sizeof(char), 1, imageSize, file);
+	fread(data, 1, imageSize, file);
 
 	//Everything is in memory now, the file can be closed
 	fclose(file);
@@ -479,11 +932,8 @@ bool loadOBJ(const char * path, std::vector<glm::vec3> & out_vertices, std::vect
 	std::vector< glm::vec2 > temp_uvs;
 	std::vector< glm::vec3 > temp_normals;
 
-	FILE * file = NULL;
-
-	errno_t err;
-
-	if ((err = fopen_s(&file, path, "r")) != 0) {
+	FILE * file = fopen(path, "r");
+	if (file == NULL) {
 		printf("Impossible to open the file !\n");
 		return false;
 	}
@@ -492,32 +942,33 @@ bool loadOBJ(const char * path, std::vector<glm::vec3> & out_vertices, std::vect
 
 		char lineHeader[128];
 		// read the first word of the line
-		int res = fscanf_s(file, "%s", lineHeader, 128);
+		int res = fscanf(file, "%127s", lineHeader);
 		if (res == EOF)
 			break; // EOF = End Of File. Quit the loop.
 
 				   // else : parse lineHeader
 		if (strcmp(lineHeader, "v") == 0) {
 			glm::vec3 vertex;
-			fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+			fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
 			temp_vertices.push_back(vertex);
 		}
 		else if (strcmp(lineHeader, "vt") == 0) {
 			glm::vec2 uv;
-			fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
+			fscanf(file, "%f %f\n", &uv.x, &uv.y);
 			temp_uvs.push_back(uv);
 		}
 		else if (strcmp(lineHeader, "vn") == 0) {
 			glm::vec3 normal;
-			fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
 			temp_normals.push_back(normal);
 		}
 		else if (strcmp(lineHeader, "f") == 0) {
 			std::string vertex1, vertex2, vertex3;
 			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
+			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
 			if (matches != 9) {
 				printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+				fclose(file);
 				return false;
 			}
 			vertexIndices.push_back(vertexIndex[0]);
@@ -531,6 +982,7 @@ bool loadOBJ(const char * path, std::vector<glm::vec3> & out_vertices, std::vect
 			normalIndices.push_back(normalIndex[2]);
 		}
 	}
+	fclose(file);
 
 	// For each vertex of each triangle
 	for (unsigned int i = 0; i < vertexIndices.size(); i++) {
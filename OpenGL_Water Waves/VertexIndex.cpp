@@ -0,0 +1,234 @@
+#include "stdafx.h"
+#include "VertexIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Shards of the parallel variant, chosen by the top bits of the hash
+#define INDEX_SHARD_BITS 6
+#define INDEX_SHARDS (1 << INDEX_SHARD_BITS)
+
+// Inputs below this are indexed on the calling thread
+#define INDEX_PARALLEL_MIN 65536
+
+#define INDEX_NONE 0xffffffffu
+
+namespace {
+
+	// The 8 floats of a vertex as bits, without any padding
+	struct VertexKey {
+		uint32_t bits[8];
+
+		bool operator==(const VertexKey & other) const {
+			return memcmp(bits, other.bits, sizeof(bits)) == 0;
+		}
+	};
+
+	inline uint32_t floatBits(float f) {
+		f += 0.0f; // -0 becomes 0
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	inline VertexKey vertexKey(const glm::vec3 & p, const glm::vec2 & uv, const glm::vec3 & n) {
+		VertexKey k = { { floatBits(p.x), floatBits(p.y), floatBits(p.z), floatBits(uv.x), floatBits(uv.y), floatBits(n.x), floatBits(n.y), floatBits(n.z) } };
+		return k;
+	}
+
+	inline uint32_t hashKey(const VertexKey & k) {
+		uint32_t h = 0x811C9DC5u;
+		for (int i = 0; i < 8; i++) {
+			uint32_t b = k.bits[i] * 0xCC9E2D51u;
+			b = (b << 15) | (b >> 17);
+			h ^= b * 0x1B873593u;
+			h = ((h << 13) | (h >> 19)) * 5 + 0xE6546B64u;
+		}
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	inline size_t tableSize(size_t items) {
+		size_t capacity = 16;
+		while (capacity < 2 * items) capacity *= 2;
+		return capacity;
+	}
+
+	void appendVertex(const glm::vec3 & p, const glm::vec2 & uv, const glm::vec3 & n,
+		std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals) {
+		out_vertices.push_back(p);
+		out_uvs.push_back(uv);
+		out_normals.push_back(n);
+	}
+}
+
+void indexVBO(
+	const std::vector<glm::vec3> & in_vertices,
+	const std::vector<glm::vec2> & in_uvs,
+	const std::vector<glm::vec3> & in_normals,
+
+	std::vector<GLuint> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+) {
+	size_t n = in_vertices.size();
+	GLuint base = (GLuint)out_vertices.size();
+
+	// open addressing with linear probing, slots hold output indices
+	size_t capacity = tableSize(n);
+	std::vector<GLuint> table(capacity, INDEX_NONE);
+	std::vector<VertexKey> keys;
+	out_indices.reserve(out_indices.size() + n);
+
+	for (size_t i = 0; i < n; i++) {
+		VertexKey key = vertexKey(in_vertices[i], in_uvs[i], in_normals[i]);
+		size_t slot = hashKey(key) & (capacity - 1);
+		for (;;) {
+			GLuint index = table[slot];
+			if (index == INDEX_NONE) {
+				table[slot] = (GLuint)keys.size();
+				keys.push_back(key);
+				appendVertex(in_vertices[i], in_uvs[i], in_normals[i], out_vertices, out_uvs, out_normals);
+				out_indices.push_back(base + table[slot]);
+				break;
+			}
+			if (keys[index] == key) {
+				out_indices.push_back(base + index);
+				break;
+			}
+			slot = (slot + 1) & (capacity - 1);
+		}
+	}
+}
+
+void indexVBO_parallel(
+	const std::vector<glm::vec3> & in_vertices,
+	const std::vector<glm::vec2> & in_uvs,
+	const std::vector<glm::vec3> & in_normals,
+
+	std::vector<GLuint> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	ThreadPool & pool
+) {
+	int n = (int)in_vertices.size();
+	if (n < INDEX_PARALLEL_MIN || pool.size() == 0) {
+		indexVBO(in_vertices, in_uvs, in_normals, out_indices, out_vertices, out_uvs, out_normals);
+		return;
+	}
+
+	const int grain = 1 << 14;
+	int blocks = (n + grain - 1) / grain;
+
+	// 1. hash every vertex and count each block's share of every shard
+	std::vector<uint32_t> hashes(n);
+	std::vector<int> counts((size_t)blocks * INDEX_SHARDS, 0);
+	pool.parallelFor(0, blocks, 1, [&](int first, int last) {
+		for (int b = first; b < last; b++) {
+			int * count = &counts[(size_t)b * INDEX_SHARDS];
+			for (int i = b * grain; i < std::min(n, (b + 1) * grain); i++) {
+				hashes[i] = hashKey(vertexKey(in_vertices[i], in_uvs[i], in_normals[i]));
+				count[hashes[i] >> (32 - INDEX_SHARD_BITS)]++;
+			}
+		}
+	});
+
+	// 2. stable scatter of the vertex numbers into their shards, so every
+	// shard sees its vertices in input order
+	std::vector<int> shardStart(INDEX_SHARDS + 1, 0);
+	std::vector<int> offsets((size_t)blocks * INDEX_SHARDS);
+	int at = 0;
+	for (int s = 0; s < INDEX_SHARDS; s++) {
+		shardStart[s] = at;
+		for (int b = 0; b < blocks; b++) {
+			offsets[(size_t)b * INDEX_SHARDS + s] = at;
+			at += counts[(size_t)b * INDEX_SHARDS + s];
+		}
+	}
+	shardStart[INDEX_SHARDS] = at;
+
+	std::vector<int> order(n);
+	pool.parallelFor(0, blocks, 1, [&](int first, int last) {
+		for (int b = first; b < last; b++) {
+			int * offset = &offsets[(size_t)b * INDEX_SHARDS];
+			for (int i = b * grain; i < std::min(n, (b + 1) * grain); i++) {
+				order[offset[hashes[i] >> (32 - INDEX_SHARD_BITS)]++] = i;
+			}
+		}
+	});
+
+	// 3. deduplicate each shard on its own, mapping every vertex to the first
+	// vertex equal to it
+	std::vector<int> firstEqual(n);
+	pool.parallelFor(0, INDEX_SHARDS, 1, [&](int first, int last) {
+		std::vector<int> table;
+		for (int s = first; s < last; s++) {
+			int begin = shardStart[s], end = shardStart[s + 1];
+			size_t capacity = tableSize(end - begin);
+			table.assign(capacity, -1);
+
+			for (int k = begin; k < end; k++) {
+				int i = order[k];
+				VertexKey key = vertexKey(in_vertices[i], in_uvs[i], in_normals[i]);
+				size_t slot = hashes[i] & (capacity - 1);
+				for (;;) {
+					int j = table[slot];
+					if (j < 0) {
+						table[slot] = firstEqual[i] = i;
+						break;
+					}
+					if (hashes[j] == hashes[i] && vertexKey(in_vertices[j], in_uvs[j], in_normals[j]) == key) {
+						firstEqual[i] = j;
+						break;
+					}
+					slot = (slot + 1) & (capacity - 1);
+				}
+			}
+		}
+	});
+
+	// 4. number the first occurrences in input order, as the sequential version does
+	std::vector<int> uniqueInBlock(blocks + 1, 0);
+	pool.parallelFor(0, blocks, 1, [&](int first, int last) {
+		for (int b = first; b < last; b++) {
+			int count = 0;
+			for (int i = b * grain; i < std::min(n, (b + 1) * grain); i++) count += firstEqual[i] == i;
+			uniqueInBlock[b + 1] = count;
+		}
+	});
+	for (int b = 0; b < blocks; b++) uniqueInBlock[b + 1] += uniqueInBlock[b];
+
+	GLuint base = (GLuint)out_vertices.size();
+	size_t indexBase = out_indices.size();
+	out_vertices.resize(base + uniqueInBlock[blocks]);
+	out_uvs.resize(base + uniqueInBlock[blocks]);
+	out_normals.resize(base + uniqueInBlock[blocks]);
+	out_indices.resize(indexBase + n);
+
+	// firstEqual[i] <= i, so the number of a first occurrence is known once its
+	// own block is done: copy the unique vertices, then resolve the duplicates
+	std::vector<GLuint> number(n);
+	pool.parallelFor(0, blocks, 1, [&](int first, int last) {
+		for (int b = first; b < last; b++) {
+			GLuint next = base + uniqueInBlock[b];
+			for (int i = b * grain; i < std::min(n, (b + 1) * grain); i++) {
+				if (firstEqual[i] != i) continue;
+				number[i] = next;
+				out_vertices[next] = in_vertices[i];
+				out_uvs[next] = in_uvs[i];
+				out_normals[next] = in_normals[i];
+				next++;
+			}
+		}
+	});
+	pool.parallelFor(0, n, grain, [&](int first, int last) {
+		for (int i = first; i < last; i++) out_indices[indexBase + i] = number[firstEqual[i]];
+	});
+}
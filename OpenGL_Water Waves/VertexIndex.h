@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef __VERTEX_INDEX_H__
+#define __VERTEX_INDEX_H__
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class ThreadPool;
+
+// Hash based replacements for the std::map indexVBO of Utilities.hpp, with 32 bit
+// indices. Vertices are merged when position, uv and normal are bit for bit equal,
+// with -0 equal to 0. Outputs are appended to, in first occurrence order.
+void indexVBO(
+	const std::vector<glm::vec3> & in_vertices,
+	const std::vector<glm::vec2> & in_uvs,
+	const std::vector<glm::vec3> & in_normals,
+
+	std::vector<GLuint> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+
+// Same result as indexVBO, with the work split in hash shards across the pool
+void indexVBO_parallel(
+	const std::vector<glm::vec3> & in_vertices,
+	const std::vector<glm::vec2> & in_uvs,
+	const std::vector<glm::vec3> & in_normals,
+
+	std::vector<GLuint> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	ThreadPool & pool
+);
+
+#endif __VERTEX_INDEX_H__
@@ -0,0 +1,77 @@
+#version 430
+
+// Wave band range of each screen tile, see BandTiles.h. A work group per tile
+// bounds the lod of the projected grid on an 8x8 lattice over the tile grown
+// by a grid cell on each side, since fragments interpolate the lod of the grid
+// vertices around them, and keeps the union of the band ranges the fragments
+// there would loop over.
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 0, rgba8ui) uniform writeonly uimage2D tileBounds; // first band, band count
+
+uniform mat4 screenToCamera; // screen space to camera space
+uniform mat4 cameraToWorld; // camera space to world space
+uniform vec3 worldCamera; // camera position in world space
+
+uniform float nbWaves; // number of waves
+uniform float heightOffset; // so that surface height is centered around z = 0
+uniform float displacementMax; // sum of the wave amplitudes, no vertex moves further
+
+// grid cell size in pixels, angle under which a grid cell is seen,
+// and parameters of the geometric series used for wavelengths
+uniform vec4 lods;
+
+uniform float nyquistMin; // Nmin parameter
+uniform float nyquistMax; // Nmax parameter
+
+uniform ivec2 renderSize; // pixels covered by the tiles
+uniform int tileSize; // pixels per side of a tile
+
+shared int firstBand;
+shared int lastBand;
+
+void main() {
+	if (gl_LocalInvocationIndex == 0u) {
+		firstBand = int(nbWaves);
+		lastBand = -1;
+	}
+	barrier();
+
+	// the ray of this lattice point, as waves2.vs.glsl casts it for a vertex
+	vec2 tile = vec2(gl_WorkGroupID.xy) * float(tileSize);
+	vec2 pixel = tile - lods.x + vec2(gl_LocalInvocationID.xy) / 7.0 * (float(tileSize) + 2.0 * lods.x);
+	vec2 screen = clamp(pixel / vec2(renderSize), 0.0, 1.0) * 2.0 - 1.0;
+	vec3 cameraDir = normalize((screenToCamera * vec4(screen, 0.0, 1.0)).xyz);
+	vec3 worldDir = (cameraToWorld * vec4(cameraDir, 0.0)).xyz;
+
+	// a vertex whose displaced position is seen along this ray started on the
+	// mean plane within displacementMax of where the ray crosses the wave
+	// slab. Its lod, lods.y * R^2 / height for a vertex at distance R, is
+	// between those of the nearest and farthest such points. Above the horizon
+	// the lod is unbounded, which leaves no band but the longest wave as the
+	// upper end.
+	int iMin = int(nbWaves);
+	int iMAX = int(nbWaves) - 1;
+	if (worldDir.z < 0.0) {
+		float height = worldCamera.z - heightOffset;
+		float slope = length(worldDir.xy) / -worldDir.z; // horizontal meters per meter of descent
+		float near = max(slope * max(height - displacementMax, 0.0) - displacementMax, 0.0);
+		float far = slope * (height + displacementMax) + displacementMax;
+		float lodMin = lods.y * (height * height + near * near) / height;
+		float lodMax = lods.y * (height * height + far * far) / height;
+		iMAX = int(min(ceil((log2(nyquistMax * lodMax) - lods.z) * lods.w), nbWaves - 1.0));
+		iMin = int(clamp(floor((log2(nyquistMin * lodMin / lods.x) - lods.z) * lods.w), 0.0, nbWaves));
+	}
+
+	// both ends grow with the lod, so the union of the lattice ranges holds
+	// every range in between
+	atomicMin(firstBand, iMin);
+	atomicMax(lastBand, iMAX);
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0u) {
+		int count = max(lastBand - firstBand + 1, 0);
+		imageStore(tileBounds, ivec2(gl_WorkGroupID.xy), uvec4(count > 0 ? firstBand : 0, count, 0, 0));
+	}
+}
@@ -1,6 +1,7 @@
  #pragma once
 
 #include "controls.h"
+#include "Trace.h"
 
 double Controls::yScroll = 0;
 
@@ -12,6 +13,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 }
 
 void Controls::computeMatrixFromInputs() {
+	TRACE_SCOPE("Controls::computeMatrixFromInputs");
 
 	//DeltaTime calculation
 
@@ -0,0 +1,80 @@
+#version 430
+
+// Fragment stage band loop, linked into the ocean lighting and G-buffer
+// programs. Adds the waves too short for the grid but long enough for a pixel
+// to dPdu and dPdv, and moves the ones shorter than a pixel into the slope
+// variance.
+
+const float g = 9.8196;
+const float PI = 3.141592657;
+
+uniform float nbWaves; // number of waves
+uniform float[60] h;
+uniform float[60] omega;
+uniform float[60] kx;
+uniform float[60] ky;
+
+uniform float time; // current time
+
+// grid cell size in pixels, angle under which a grid cell is seen,
+// and parameters of the geometric series used for wavelengths
+uniform vec4 lods;
+
+uniform float nyquistMin; // Nmin parameter
+uniform float nyquistMax; // Nmax parameter
+
+// per tile loop bounds, see BandTiles.h
+uniform bool bandTiles; // false computes them for each fragment
+uniform usampler2D bandTileBounds; // first band, band count
+uniform int bandTileSize; // pixels per side of a tile
+
+// The tile pre-pass found no band for any pixel around this fragment
+bool tileWithoutBands() {
+	return bandTiles && texelFetch(bandTileBounds, ivec2(gl_FragCoord.xy) / bandTileSize, 0).y == 0u;
+}
+
+// texelScale is the side of the block of lods.x sized texels the fragment
+// stands for, waves shorter than the block fold into the variance
+void refineBands(vec2 u, float lod, float texelScale, inout vec3 dPdu, inout vec3 dPdv, inout vec2 sigmaSq) {
+	float cells = lods.x / texelScale;
+
+	// the tile's range holds this fragment's, the bands outside of it add
+	// nothing, and every fragment of the tile runs the same iterations
+    float iMAX, iMin;
+	if (bandTiles) {
+		uvec2 tile = texelFetch(bandTileBounds, ivec2(gl_FragCoord.xy) / bandTileSize, 0).xy;
+		iMin = float(tile.x);
+		iMAX = float(tile.x + tile.y) - 1.0;
+	}
+	else {
+		iMAX = min(ceil((log2(nyquistMax * lod) - lods.z) * lods.w), nbWaves - 1.0);
+		iMin = max(0.0, floor((log2(nyquistMin * lod / cells) - lods.z) * lods.w));
+	}
+    float iMax = floor((log2(nyquistMin * lod) - lods.z) * lods.w);
+    for (float i = iMin; i <= iMAX; i += 1.0) {
+         
+		int j = int(i);
+        vec4 wt = vec4(h[j], omega[j], kx[j], ky[j]);
+
+        float phase = wt.y * time - dot(wt.zw, u);
+        float s = sin(phase);
+        float c = cos(phase);
+        float overk = g / (wt.y * wt.y);
+
+        float wp = smoothstep(nyquistMin, nyquistMax, (2.0 * PI) * overk / lod);
+        float wn = smoothstep(nyquistMin, nyquistMax, (2.0 * PI) * overk / lod * cells);
+
+        vec3 factor = (1.0 - wp) * wn * wt.x * vec3(wt.zw * overk, 1.0);
+
+        vec3 dPd = factor * vec3(c, c, -s);
+        dPdu -= dPd * wt.z;
+        dPdv -= dPd * wt.w;
+
+        wt.zw *= overk;
+        float kh = i < iMax ? wt.x / overk : 0.0;
+        float wkh = (1.0 - wn) * kh;
+        sigmaSq -= vec2(wt.z * wt.z, wt.w * wt.w) * (sqrt(1.0 - wkh * wkh) - sqrt(1.0 - kh * kh));
+    }
+	
+    sigmaSq = max(sigmaSq, 2e-5);
+}
@@ -0,0 +1,47 @@
+#version 430
+
+// Reduced rate pass of the ocean, see OceanGBuffer.h. Runs the band loop of
+// ocean_bands.glsl for the G-buffer texels; lods.x is the grid cell size in
+// G-buffer texels, so waves shorter than a texel end up in the variance. Past
+// the quarter rate distance only the even texels run it, for a 2x2 block.
+
+layout (location = 0) out vec4 Normal;   // wind space normal, distance to the camera
+layout (location = 1) out vec4 Variance; // slope variance in wind space
+
+uniform vec3 worldCamera; // camera position in world space
+uniform float fullRateDistance; // closer fragments are shaded at full rate
+uniform float quarterRateDistance; // farther fragments are shaded at quarter rate
+
+const float MAX_DISTANCE = 60000.0; // the targets are half float
+
+in float lod;
+in vec2 u; // coordinates in wind space used to compute P(u)
+in vec3 P; // wave point P(u) in world space
+in vec3 _dPdu; // dPdu in wind space, used to compute N
+in vec3 _dPdv; // dPdv in wind space, used to compute N
+in vec2 _sigmaSq; // variance of unresolved waves in wind space
+
+void refineBands(vec2 u, float lod, float texelScale, inout vec3 dPdu, inout vec3 dPdv, inout vec2 sigmaSq);
+
+void main() {
+	// the lighting pass never reads texels well inside the full rate region,
+	// the margin keeps neighbours for the pixels just past its edge
+	float distance = min(length(worldCamera - P), MAX_DISTANCE);
+	if (distance < 0.75 * fullRateDistance) {
+		discard;
+	}
+	// the odd texels are left out well past the quarter rate distance, the
+	// margin again keeps them for the pixels just before it
+	bool quarter = distance >= quarterRateDistance;
+	if (distance > 1.25 * quarterRateDistance && any(notEqual(ivec2(gl_FragCoord.xy) & 1, ivec2(0)))) {
+		discard;
+	}
+
+    vec3 dPdu = _dPdu;
+    vec3 dPdv = _dPdv;
+    vec2 sigmaSq = _sigmaSq;
+	refineBands(u, lod, quarter ? 2.0 : 1.0, dPdu, dPdv, sigmaSq);
+
+	Normal = vec4(normalize(cross(dPdu, dPdv)), distance);
+	Variance = vec4(sigmaSq, 0.0, 0.0);
+}
@@ -0,0 +1,14 @@
+#version 430 core
+
+in vec2 UV;
+in vec3 Normal;
+
+uniform vec3 lightDirection;
+
+out vec4 FragColor;
+
+void main()
+{
+    float diffuse = max(dot(normalize(Normal), lightDirection), 0.0);
+    FragColor = vec4(vec3(0.1 + 0.9 * diffuse), 1.0);
+}
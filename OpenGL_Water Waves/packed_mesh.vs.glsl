@@ -0,0 +1,27 @@
+#version 430 core
+
+// MeshCache vertices: position, half float uv, snorm16 octahedral normal
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 uv;
+layout (location = 2) in vec2 octahedral;
+
+uniform mat4 MVP;
+
+out vec2 UV;
+out vec3 Normal;
+
+// inverse of encodeOctahedral in MeshCache.cpp
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    UV = uv;
+    Normal = decodeOctahedral(octahedral);
+    gl_Position = MVP * vec4(position, 1.0);
+}
@@ -0,0 +1,55 @@
+#version 430 core
+
+layout (location = 0) out vec4 FragColor; // color, distance for the next frame's rejection
+
+uniform sampler2D sceneColor;
+uniform sampler2D sceneMotion; // previous uv, previous distance, distance (negative when not shaded)
+uniform sampler2D history;     // previous resolved frame, distance in alpha
+uniform vec2 historyScale;     // render size / texture size, frames cover a corner
+uniform ivec2 renderSize;
+uniform bool historyValid;
+
+// relative distance difference above which the history saw another surface
+const float DISOCCLUSION = 0.05;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 motion = texelFetch(sceneMotion, pixel, 0);
+    vec3 color = texelFetch(sceneColor, pixel, 0).rgb;
+
+    // shaded this frame, or sky
+    if (motion.w >= 0.0) {
+        FragColor = vec4(color, motion.w);
+        return;
+    }
+
+    // the neighbours shaded this frame bound what the history may bring back,
+    // whatever changed since (sun glints, a new wave set, a toggled mode)
+    vec3 lo = vec3(1e9), hi = vec3(-1e9), sum = vec3(0.0);
+    float n = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 q = clamp(pixel + ivec2(x, y), ivec2(0), renderSize - 1);
+            if (texelFetch(sceneMotion, q, 0).w < 0.0) continue;
+            vec3 c = texelFetch(sceneColor, q, 0).rgb;
+            lo = min(lo, c);
+            hi = max(hi, c);
+            sum += c;
+            n += 1.0;
+        }
+    }
+    vec3 spatial = n > 0.0 ? sum / n : color;
+
+    vec2 uv = motion.xy;
+    if (historyValid && n > 0.0 && all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)))) {
+        vec4 previous = texture(history, uv * historyScale);
+        if (abs(previous.a - motion.z) < DISOCCLUSION * motion.z) {
+            FragColor = vec4(clamp(previous.rgb, lo, hi), -motion.w);
+            return;
+        }
+    }
+
+    // disoccluded or off screen a frame ago
+    FragColor = vec4(spatial, -motion.w);
+}
@@ -0,0 +1,17 @@
+#version 430 core
+
+in vec2 TexCoords;
+out vec4 color;
+
+// distance field atlas, 0.5 is the outline
+uniform sampler2D text;
+uniform vec3 textColor;
+
+void main()
+{
+    float distance = texture(text, TexCoords).r;
+    // antialias over about one screen pixel whatever the scale
+    float width = fwidth(distance);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    color = vec4(textColor, alpha);
+}
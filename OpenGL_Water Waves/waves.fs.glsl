@@ -29,6 +29,7 @@ const vec3 betaMEx = betaMSca / 0.9;
 const float mieG = 0.8;
 
 layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 Motion; // previous uv, previous distance, distance (negative when not shaded)
 
 uniform mat4 screenToCamera; // screen space to camera space
 uniform mat4 cameraToWorld; // camera space to world space
@@ -39,34 +40,38 @@ uniform vec3 worldCamera; // camera position in world space
 uniform vec3 worldSunDir; // sun direction in world space
 
 
-uniform float nbWaves; // number of waves
-uniform float[60] h;
-uniform float[60] omega;
-uniform float[60] kx;
-uniform float[60] ky;
-
 uniform sampler2D transmittanceSampler;
 uniform sampler2D skyIrradianceSampler;
 uniform samplerCube irradianceMap;
 uniform samplerCube radianceMap;
-uniform sampler2D skyDome;
+uniform sampler2DArray skyDome;
+uniform vec3 skyLayers; // previous layer, current layer, crossfade weight of the current one
 
 uniform float heightOffset; // so that surface height is centered around z = 0
 uniform vec2 sigmaSqTotal; // total x and y variance in wind space
-uniform float time; // current time
 uniform float sunLuminance;
 
-// grid cell size in pixels, angle under which a grid cell is seen,
-// and parameters of the geometric series used for wavelengths
-uniform vec4 lods;
-
-uniform float nyquistMin; // Nmin parameter
-uniform float nyquistMax; // Nmax parameter
-
 uniform bool NormalView;
 uniform bool reflactance;
 uniform bool Irradiance;
 
+// temporal shading, see TemporalShading.h
+uniform int temporalPattern; // 0 shades every pixel, 1 a checkerboard, 2 one pixel of each 2x2 quad
+uniform int temporalPhase;
+
+const float MAX_DISTANCE = 60000.0; // TEMPORAL_MAX_DISTANCE, the motion target is half float
+
+// reduced rate bands, see OceanGBuffer.h
+uniform int gbufferFactor; // 1 runs the band loop for every pixel, 2 or 4 reads it from the G-buffer
+uniform sampler2D bandNormals; // wind space normal, distance
+uniform sampler2D bandVariance; // slope variance in wind space
+uniform ivec2 gbufferSize; // G-buffer texels covering the rendered frame
+uniform float fullRateDistance; // closer pixels run the band loop themselves
+uniform float quarterRateDistance; // farther pixels read the even G-buffer texels only
+
+// relative distance difference at which a G-buffer texel's weight falls to 1/e
+const float BILATERAL_DISTANCE = 0.1;
+
 vec3 seaColor = vec3(10 /255.0, 40/255.0, 120/255.0); // sea bottom color
 
 in float s;
@@ -76,6 +81,8 @@ in vec3 P; // wave point P(u) in world space
 in vec3 _dPdu; // dPdu in wind space, used to compute N
 in vec3 _dPdv; // dPdv in wind space, used to compute N
 in vec2 _sigmaSq; // variance of unresolved waves in wind space
+in vec4 previousClip; // P(u) one frame earlier, in clip space
+in float previousDistance;
 
 uniform float hdrExposure;
 float R = 0.02; //Fresnel factor for water
@@ -124,14 +131,14 @@ vec2 getIrradianceUV(float r, float muS) {
 
 vec3 irradiance(sampler2D sampler, float r, float muS) {
     vec2 uv = getIrradianceUV(r, muS);
-    return texture2D(sampler, uv).rgb;
+    return texture(sampler, uv).rgb;
 }
 
 // transmittance(=transparency) of atmosphere for infinite ray (r,mu)
 // (mu=cos(view zenith angle)), intersections with ground ignored
 vec3 transmittance(float r, float mu) {
     vec2 uv = getTransmittanceUV(r, mu);
-    return texture2D(transmittanceSampler, uv).rgb;
+    return texture(transmittanceSampler, uv).rgb;
 }
 
 // transmittance(=transparency) of atmosphere for infinite ray (r,mu)
@@ -183,11 +190,57 @@ vec2 reflection(vec3 V, vec3 N){
 }
 
 vec3 skyRadiance(vec3 V, vec3 N){    
-	return (vec4(0.0) + texture2D(skyDome, reflection(V,N) * ellipticalProps + 0.5)).rgb;
+	vec2 uv = reflection(V,N) * ellipticalProps + 0.5;
+	vec3 previous = texture(skyDome, vec3(uv, skyLayers.x)).rgb;
+	vec3 current = texture(skyDome, vec3(uv, skyLayers.y)).rgb;
+	return mix(previous, current, skyLayers.z);
 }
 
 // ----------------------------------------------------------------------------
 
+// ---------------------------------------------------------------------------
+// BANDS
+// ---------------------------------------------------------------------------
+
+// in ocean_bands.glsl
+void refineBands(vec2 u, float lod, float texelScale, inout vec3 dPdu, inout vec3 dPdv, inout vec2 sigmaSq);
+bool tileWithoutBands();
+
+// Bilateral upsample of the G-buffer: the four texels around the pixel,
+// weighted bilinearly and by how close their distance to the camera is to
+// the pixel's. Past the quarter rate distance the four are even texels, the
+// only ones the G-buffer pass shaded there. False when none of them saw this
+// surface, at silhouettes against the sky or across the edge of the full rate
+// region.
+bool upsampleBands(float distance, out vec3 windNormal, out vec2 sigmaSq) {
+	int step = distance >= quarterRateDistance ? 2 : 1;
+	ivec2 last = (gbufferSize - 1) / step * step;
+	vec2 texel = (gl_FragCoord.xy / float(gbufferFactor) - 0.5) / float(step);
+	ivec2 base = ivec2(floor(texel));
+	vec2 f = texel - vec2(base);
+
+	vec3 n = vec3(0.0);
+	vec2 s = vec2(0.0);
+	float total = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 q = clamp((base + offset) * step, ivec2(0), last);
+		vec4 band = texelFetch(bandNormals, q, 0);
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float w = bilinear.x * bilinear.y + 1e-3;
+		w *= exp(-abs(band.w - distance) / (BILATERAL_DISTANCE * distance));
+		n += band.xyz * w;
+		s += texelFetch(bandVariance, q, 0).xy * w;
+		total += w;
+	}
+	if (total < 1e-4 || dot(n, n) == 0.0) {
+		return false;
+	}
+	windNormal = normalize(n);
+	sigmaSq = max(s / total, 2e-5);
+	return true;
+}
+
 // ---------------------------------------------------------------------------
 // REFLECTED SUN RADIANCE
 // ---------------------------------------------------------------------------
@@ -239,45 +292,40 @@ float reflectedSunRadiance(vec3 L, vec3 V, vec3 N, vec3 Tx, vec3 Ty, vec2 sigmaS
 
 
 void main() {
-    vec3 dPdu = _dPdu;
-    vec3 dPdv = _dPdv;
-    vec2 sigmaSq = _sigmaSq;
+	// in temporal mode only this frame's phase is shaded, the resolve pass
+	// reprojects the previous frame into the other pixels
+	float distance = min(length(worldCamera - P), MAX_DISTANCE);
+	bool shaded = true;
+	if (temporalPattern != 0) {
+		ivec2 pixel = ivec2(gl_FragCoord.xy);
+		shaded = temporalPattern == 1 ? ((pixel.x + pixel.y + temporalPhase) & 1) == 0 : ((pixel.x & 1) + 2 * (pixel.y & 1)) == temporalPhase;
+	}
+	Motion = vec4(previousClip.xy / previousClip.w * 0.5 + 0.5, min(previousDistance, MAX_DISTANCE), shaded ? distance : -distance);
+	if (!shaded) {
+		FragColor = vec4(0.0);
+		return;
+	}
 
-	
-    float iMAX = min(ceil((log2(nyquistMax * lod) - lods.z) * lods.w), nbWaves - 1.0);
-    float iMax = floor((log2(nyquistMin * lod) - lods.z) * lods.w);
-    float iMin = max(0.0, floor((log2(nyquistMin * lod / lods.x) - lods.z) * lods.w));
-    for (float i = iMin; i <= iMAX; i += 1.0) {
-         
-		int j = int(i);
-        vec4 wt = vec4(h[j], omega[j], kx[j], ky[j]);
-
-        float phase = wt.y * time - dot(wt.zw, u);
-        float s = sin(phase);
-        float c = cos(phase);
-        float overk = g / (wt.y * wt.y);
-
-        float wp = smoothstep(nyquistMin, nyquistMax, (2.0 * PI) * overk / lod);
-        float wn = smoothstep(nyquistMin, nyquistMax, (2.0 * PI) * overk / lod * lods.x);
-
-        vec3 factor = (1.0 - wp) * wn * wt.x * vec3(wt.zw * overk, 1.0);
-
-        vec3 dPd = factor * vec3(c, c, -s);
-        dPdu -= dPd * wt.z;
-        dPdv -= dPd * wt.w;
-
-        wt.zw *= overk;
-        float kh = i < iMax ? wt.x / overk : 0.0;
-        float wkh = (1.0 - wn) * kh;
-        sigmaSq -= vec2(wt.z * wt.z, wt.w * wt.w) * (sqrt(1.0 - wkh * wkh) - sqrt(1.0 - kh * kh));
-    }
-	
-    sigmaSq = max(sigmaSq, 2e-5);
+	// where no wave falls between a pixel and a grid cell the vertex slopes
+	// are the surface, far from the camera the bands come from the reduced
+	// rate G-buffer
+	vec3 windNormal;
+	vec2 sigmaSq;
+	if (tileWithoutBands()) {
+		windNormal = normalize(cross(_dPdu, _dPdv));
+		sigmaSq = max(_sigmaSq, 2e-5);
+	}
+	else if (gbufferFactor <= 1 || distance < fullRateDistance || !upsampleBands(distance, windNormal, sigmaSq)) {
+		vec3 dPdu = _dPdu;
+		vec3 dPdv = _dPdv;
+		sigmaSq = _sigmaSq;
+		refineBands(u, lod, 1.0, dPdu, dPdv, sigmaSq);
+		windNormal = normalize(cross(dPdu, dPdv));
+	}
 
     vec3 V = normalize(worldCamera - P);
 	vec3 H = normalize(worldSunDir + V);
 
-    vec3 windNormal = normalize(cross(dPdu, dPdv));
     vec3 N = vec3(windToWorld * windNormal.xy, windNormal.z);
     if (dot(V, N) < 0.0) {
         N = reflect(N, V); // reflects backfacing normals
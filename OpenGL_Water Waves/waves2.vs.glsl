@@ -31,6 +31,12 @@ uniform vec4 lods;
 uniform float nyquistMin; // Nmin parameter
 uniform float nyquistMax; // Nmax parameter
 
+// temporal shading, see TemporalShading.h
+uniform int temporalPattern; // 0 when every pixel is shaded and no motion is needed
+uniform float previousTime;
+uniform mat4 previousMVP;
+uniform vec3 previousCamera;
+
 out float s;
 out float lod;
 out vec2 u; // coordinates in wind space used to compute P(u)
@@ -38,6 +44,8 @@ out vec3 P; // wave point P(u) in world space
 out vec3 _dPdu; // dPdu in wind space, used to compute N
 out vec3 _dPdv; // dPdv in wind space, used to compute N
 out vec2 _sigmaSq; // variance of unresolved waves in wind space
+out vec4 previousClip; // P(u) one frame earlier, in clip space
+out float previousDistance; // and its distance to the camera then
 
 void main() {
 
@@ -61,6 +69,7 @@ void main() {
 	float waveHeight = 0;
 	float waveDrag = 0;
 	vec3 waveDisplacement = vec3(0, 0, heightOffset);
+	vec3 previousDisplacement = vec3(0, 0, heightOffset);
 
 	float iMin = max(0.0, floor((log2(nyquistMin * lod) - lods.z) * lods.w));
 
@@ -84,6 +93,12 @@ void main() {
         dPdu -= dPd * k.x;
         dPdv -= dPd * k.y;
 
+		// the same point of the surface at the previous frame, for motion vectors
+		if (temporalPattern != 0) {
+			float previousPhase = omega[i] * previousTime - phase;
+			previousDisplacement += suppressedH * vec3(sin(previousPhase), sin(previousPhase), cos(previousPhase));
+		}
+
 		/* 
 		//Calculate the variance along x and y using this formula
 		// {[k(x), k(y)](i)}^2 / [k(i)]^2 * ( 1 - sqrt( 1 - k(i)^2*h(i)^2))
@@ -100,6 +115,14 @@ void main() {
 	worldPos = vec4(windToWorld * (u + waveDisplacement.xy), waveDisplacement.z, 1.0);
 	P = worldPos.xyz;
 
+	previousClip = vec4(0.0, 0.0, 0.0, 1.0);
+	previousDistance = 0.0;
+	if (temporalPattern != 0) {
+		vec3 previousP = vec3(windToWorld * (u + previousDisplacement.xy), previousDisplacement.z);
+		previousClip = previousMVP * vec4(previousP, 1.0);
+		previousDistance = length(previousCamera - previousP);
+	}
+
 
 	
 	if( t > 0)